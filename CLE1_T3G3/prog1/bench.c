@@ -0,0 +1,423 @@
+/**
+ *  \file bench.c
+ *
+ *  \brief Microbenchmarks of the text processing primitives.
+ *
+ *  Each primitive is run over texts of the same size with different mixes of
+ *  characters: the texts of the dataset (dataset/text*.txt, unless other files are
+ *  given), repeated, and two synthetic ones, one with ASCII words only and the other
+ *  with many accented vowels and multi-byte separation characters (quotes, dashes).
+ *  After some warm-up runs, every run is timed and the time per byte of the text is
+ *  reported as the minimum, the median and the 10th and 90th percentiles of the runs.
+ *
+ *  Primitives:
+ *     \li counter_feed - the text fed to a word counter at once.
+ *     \li counter_feed_64 - the text fed to a word counter in pieces of 64 bytes.
+ *     \li word_boundary - the split point of each chunk (size = maxBytesPerChunk) of the text.
+ *     \li count_words - the words of each chunk, as a worker counts them.
+ *     \li get_valid_chunk - the chunks of the text read from a file (in the page cache).
+ *     \li count_buffer - the text counted by a number of threads.
+ *
+ *  With -c the results are printed as CSV, one line per primitive and text, so that the
+ *  results of two builds can be compared.
+ *
+ *  \author Artur Romão e João Reis - March 2023
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "countWords.h"
+#include "wordCounter.h"
+
+/** \brief maximum number of bytes per chunk */
+int maxBytesPerChunk;
+
+/** \brief files of the dataset, when none is given */
+static char *default_files[] = { "dataset/text0.txt", "dataset/text1.txt", "dataset/text2.txt", "dataset/text3.txt", "dataset/text4.txt" };
+
+/** \brief results of the primitives, so that they are not optimized out */
+static volatile long long sink;
+
+/** \brief number of threads of count_buffer */
+static int n_threads;
+
+/** \brief file with the text, for get_valid_chunk */
+static char *text_file;
+
+/** \brief time of a run of a primitive */
+static double run(int primitive, char *text, size_t size);
+
+/** \brief build a text from the files of the dataset */
+static char *dataset_text(char **filenames, int n_files, size_t size);
+
+/** \brief build a synthetic text */
+static char *synthetic_text(bool accents, size_t size);
+
+/** \brief print command usage */
+static void printUsage (char *cmdName);
+
+
+/** \brief names of the primitives */
+static char *primitives[] = {"counter_feed", "counter_feed_64", "word_boundary", "count_words", "get_valid_chunk", "count_buffer"};
+
+/** \brief number of primitives */
+#define N_PRIMITIVES 6
+
+
+/**
+ *  \brief Compare two times, for qsort.
+ */
+static int compare_times(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ *  \brief Percentile of the sorted times of the runs (nearest rank).
+ *
+ *  \param times contains the times, in increasing order
+ *  \param n contains the number of times
+ *  \param p contains the percentile, from 0 to 100
+ *
+ *  \return time of the percentile.
+ */
+static double percentile(double *times, int n, int p) {
+  int rank = (p * n + 99) / 100;   // ceil(p / 100 * n)
+  if (rank < 1) rank = 1;
+  return times[rank - 1];
+}
+
+
+int main(int argc, char *argv[]) {
+
+  // process command line arguments and set up variables
+  int M = 16;                   // number max of files of the dataset
+  char *filenames[M];           // files of the dataset
+  int n_files = 0;              // number of files of the dataset
+  size_t size = 4 << 20;        // number of bytes of each text (default 4 MiB)
+  int warmup = 3;               // number of runs that are not timed
+  int repetitions = 15;         // number of timed runs
+  bool csv = false;             // print the results as CSV
+  maxBytesPerChunk = 4 * 1000;  // max bytes per chunk (default 4)
+  n_threads = 4;                // number of threads of count_buffer
+  int opt;                      // selected option
+
+  do {
+    switch ((opt = getopt(argc, argv, "hf:s:w:r:m:t:c"))) {
+      case 'f': // file of the dataset
+        if (n_files >= M) {
+          fprintf(stderr, "%s: at most %d files\n", argv[0], M);
+          printUsage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        filenames[n_files++] = optarg;
+        break;
+
+      case 's': // size of the texts
+        if (atoi(optarg) < 1) {
+          fprintf(stderr, "%s: size of the texts must be greater or equal than 1 kByte\n", argv[0]);
+          printUsage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        size = (size_t)atoi(optarg) * 1024;
+        break;
+
+      case 'w': // n. of warm-up runs
+        if (atoi(optarg) < 0) {
+          fprintf(stderr, "%s: number of warm-up runs must be greater or equal than 0\n", argv[0]);
+          printUsage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        warmup = (int)atoi(optarg);
+        break;
+
+      case 'r': // n. of timed runs
+        if (atoi(optarg) < 1) {
+          fprintf(stderr, "%s: number of runs must be greater or equal than 1\n", argv[0]);
+          printUsage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        repetitions = (int)atoi(optarg);
+        break;
+
+      case 'm': // n. of max bytes per chunk
+        if (atoi(optarg) != 4 && atoi(optarg) != 8) {
+          fprintf(stderr, "%s: number of bytes must be 4 or 8 kBytes\n", argv[0]);
+          printUsage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        maxBytesPerChunk = (int)atoi(optarg) * 1000;
+        break;
+
+      case 't': // n. of threads of count_buffer
+        if (atoi(optarg) < 1) {
+          fprintf(stderr, "%s: number of threads must be greater or equal than 1\n", argv[0]);
+          printUsage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        n_threads = (int)atoi(optarg);
+        break;
+
+      case 'c': // CSV output
+        csv = true;
+        break;
+
+      case 'h': // help mode
+        printUsage(argv[0]);
+        return EXIT_SUCCESS;
+
+      case '?': // invalid option
+        fprintf(stderr, "%s: invalid option\n", argv[0]);
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  } while (opt != -1);
+
+  // the texts, all of the same size
+  char *text_names[3];
+  char *texts[3];
+  int n_texts = 0;
+
+  if (n_files == 0) {
+    n_files = sizeof(default_files) / sizeof(default_files[0]);
+    for (int i = 0; i < n_files; i++) filenames[i] = default_files[i];
+  }
+  text_names[n_texts] = "dataset";
+  texts[n_texts++] = dataset_text(filenames, n_files, size);
+  text_names[n_texts] = "ascii";
+  texts[n_texts++] = synthetic_text(false, size);
+  text_names[n_texts] = "accents";
+  texts[n_texts++] = synthetic_text(true, size);
+
+  char template[] = "/tmp/benchXXXXXX";
+  int fd = mkstemp(template);
+  if (fd < 0) {
+    perror("[error] on creating the file of the text");
+    return EXIT_FAILURE;
+  }
+  close(fd);
+  text_file = template;
+
+  double *times = (double *)malloc(repetitions * sizeof(double));
+
+  if (csv) printf("primitive,text,bytes,runs,min_ns_per_byte,p10_ns_per_byte,median_ns_per_byte,p90_ns_per_byte\n");
+  else printf("%-16s %-8s %10s %10s %10s %10s  (ns/byte, %d runs of %zu bytes)\n", "primitive", "text", "min", "p10", "median", "p90", repetitions, size);
+
+  for (int t = 0; t < n_texts; t++) {
+    // the file read by get_valid_chunk
+    FILE *f = fopen(text_file, "wb");
+    if (f == NULL || fwrite(texts[t], 1, size, f) != size) {
+      printf("[error] could not write the file %s\n", text_file);
+      return EXIT_FAILURE;
+    }
+    fclose(f);
+
+    for (int p = 0; p < N_PRIMITIVES; p++) {
+      for (int i = 0; i < warmup; i++) run(p, texts[t], size);
+      for (int i = 0; i < repetitions; i++) times[i] = run(p, texts[t], size) * 1.0e9 / (double)size;
+      qsort(times, repetitions, sizeof(double), compare_times);
+
+      if (csv) {
+        printf("%s,%s,%zu,%d,%.4f,%.4f,%.4f,%.4f\n", primitives[p], text_names[t], size, repetitions,
+               times[0], percentile(times, repetitions, 10), percentile(times, repetitions, 50), percentile(times, repetitions, 90));
+      } else {
+        printf("%-16s %-8s %10.4f %10.4f %10.4f %10.4f\n", primitives[p], text_names[t],
+               times[0], percentile(times, repetitions, 10), percentile(times, repetitions, 50), percentile(times, repetitions, 90));
+      }
+    }
+    free(texts[t]);
+  }
+
+  unlink(text_file);
+  free(times);
+
+  return EXIT_SUCCESS;
+}
+
+
+/**
+ *  \brief Time of a run of a primitive over a text.
+ *
+ *  \param primitive contains the index of the primitive
+ *  \param text contains the text
+ *  \param size contains the number of bytes of the text
+ *
+ *  \return time of the run, in seconds.
+ */
+static double run(int primitive, char *text, size_t size) {
+  struct timespec t0, t1;
+  struct WordCounter counter;
+  struct WordCount count;
+  struct ChunkData data;
+  struct File file;
+  long long result = 0;
+  char *chunk = (char *)malloc(maxBytesPerChunk * sizeof(char));
+
+  data.chunk = chunk;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+
+  switch (primitive) {
+    case 0: // counter_feed
+      counter_init(&counter);
+      counter_feed(&counter, text, size);
+      result = counter_result(&counter).nWords;
+      break;
+
+    case 1: // counter_feed_64
+      counter_init(&counter);
+      for (size_t i = 0; i < size; i += 64) counter_feed(&counter, text + i, (size - i < 64) ? size - i : 64);
+      result = counter_result(&counter).nWords;
+      break;
+
+    case 2: // word_boundary
+      for (size_t i = 0; i + maxBytesPerChunk <= size; i += maxBytesPerChunk) result += word_boundary(text + i, maxBytesPerChunk);
+      break;
+
+    case 3: // count_words
+      for (size_t i = 0; i < size; i += data.chunk_size) {
+        data.chunk = text + i;   // the chunk where it is, without the copy get_valid_chunk does
+        data.chunk_size = (size - i < (size_t)maxBytesPerChunk) ? (int)(size - i) : maxBytesPerChunk;
+        count_words(&data);
+        result += data.nWords;
+      }
+      break;
+
+    case 4: // get_valid_chunk
+      file.file_name = text_file;
+      file.reader = (struct Reader *)malloc(sizeof(struct Reader));
+      if (!open_reader(file.reader, file.file_name, 0, READ_BLOCK_SIZE)) {
+        printf("[error] could not open the file %s\n", file.file_name);
+        exit(EXIT_FAILURE);
+      }
+      do {
+        data.is_finished = false;
+        get_valid_chunk(&data, &file);
+        result += data.chunk_size;
+      } while (!data.is_finished);
+      close_reader(file.reader);
+      free(file.reader);
+      break;
+
+    case 5: // count_buffer
+      count_buffer(text, size, n_threads, &count);
+      result = count.nWords;
+      break;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  free(chunk);
+  sink += result;
+
+  return (double) (t1.tv_sec - t0.tv_sec) + 1.0e-9 * (double) (t1.tv_nsec - t0.tv_nsec);
+}
+
+
+/**
+ *  \brief Build a text from the files of the dataset, repeated up to its size.
+ *
+ *  \param filenames contains the names of the files
+ *  \param n_files contains the number of files
+ *  \param size contains the number of bytes of the text
+ *
+ *  \return text.
+ */
+static char *dataset_text(char **filenames, int n_files, size_t size) {
+  char *text = (char *)malloc(size);
+  size_t n = 0;
+
+  while (n < size) {
+    size_t before = n;
+
+    for (int i = 0; i < n_files && n < size; i++) {
+      FILE *f = fopen(filenames[i], "rb");
+      if (f == NULL) {
+        printf("[error] could not open the file %s\n", filenames[i]);
+        exit(EXIT_FAILURE);
+      }
+      n += fread(text + n, 1, size - n, f);
+      fclose(f);
+    }
+
+    if (n == before) {
+      printf("[error] the files of the dataset are empty\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  return text;
+}
+
+/**
+ *  \brief Build a synthetic text of words separated by spaces and punctuation.
+ *
+ *  The ASCII text has lowercase and some capital letters, the other one replaces about
+ *  a third of its vowels with accented ones (two bytes) and some of its separation
+ *  characters with quotes and dashes (three bytes).
+ *
+ *  \param accents contains whether there are accented vowels and multi-byte separation characters
+ *  \param size contains the number of bytes of the text
+ *
+ *  \return text.
+ */
+static char *synthetic_text(bool accents, size_t size) {
+  static const char *letters = "eeeeeaaaaooooiiiuusssrrrnnnttddmmcllppvgbfhqzjxy";
+  static const char *separators = "      ,.;:!?-()\n";
+  static const char *accented[] = {"á", "à", "ã", "â", "é", "ê", "í", "ó", "õ", "ô", "ú", "Á", "É", "Ó"};
+  static const char *wide_separators[] = {"“", "”", "–", "—", "…", "«", "»"};
+  char *text = (char *)malloc(size);
+  unsigned int seed = accents ? 2 : 1;
+  size_t n = 0;
+
+  while (n < size) {
+    // a word of 1 to 10 letters
+    int length = 1 + rand_r(&seed) % 10;
+    for (int i = 0; i < length && n < size; i++) {
+      const char *c;
+      char letter[2] = {letters[rand_r(&seed) % strlen(letters)], '\0'};
+
+      if (i == 0 && rand_r(&seed) % 8 == 0) letter[0] -= 'a' - 'A';
+      c = letter;
+      if (accents && strchr("aeiou", letter[0]) != NULL && rand_r(&seed) % 3 == 0) c = accented[rand_r(&seed) % 14];
+
+      for (size_t k = 0; c[k] != '\0' && n < size; k++) text[n++] = c[k];
+    }
+
+    // followed by a separation character
+    const char *c;
+    char separator[2] = {separators[rand_r(&seed) % strlen(separators)], '\0'};
+
+    c = separator;
+    if (accents && rand_r(&seed) % 6 == 0) c = wide_separators[rand_r(&seed) % 7];
+    for (size_t k = 0; c[k] != '\0' && n < size; k++) text[n++] = c[k];
+  }
+
+  return text;
+}
+
+
+/**
+ *  \brief Print command usage.
+ *
+ *  A message specifying how the program should be called is printed.
+ *
+ *  \param cmdName string with the name of the command
+ */
+
+static void printUsage(char *cmdName) {
+  fprintf (stderr, "\nSynopsis: %s [OPTIONS]\n"
+           "  OPTIONS:\n"
+           "  -f filename    --- add a file of the dataset to the texts (can be given more than once,\n"
+           "                     default: dataset/text0.txt to dataset/text4.txt)\n"
+           "  -s kBytes      --- set the size of each text (default: 4096)\n"
+           "  -w nRuns       --- set the number of warm-up runs (default: 3)\n"
+           "  -r nRuns       --- set the number of timed runs (default: 15)\n"
+           "  -m BytesChunk  --- set the number of bytes per chunk (default: 4)\n"
+           "  -t nThreads    --- set the number of threads of count_buffer (default: 4)\n"
+           "  -c             --- print the results as CSV\n"
+           "  -h             --- print this help\n", cmdName);
+}
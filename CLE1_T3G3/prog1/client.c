@@ -0,0 +1,270 @@
+/**
+ *  \file client.c
+ *
+ *  \brief Client of the counting daemon.
+ *
+ *  Sends a job to the daemon (see daemon.h): the files given, those of the directory
+ *  trees given, walked here, and the text read from the standard input. The results
+ *  are printed as the daemon sends them, as prog1 prints them.
+ *
+ *  The requests are sent by a thread of their own while the results are read, so
+ *  that neither side waits for the other with a full socket.
+ *
+ *  \author Artur Romão e João Reis - March 2023
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "daemon.h"
+#include "directory.h"
+#include "wordCounter.h"
+
+/** \brief files of the job */
+static struct FileList files = { NULL, 0, 0 };
+
+/** \brief whether the text read from the standard input is sent */
+static bool send_text;
+
+/** \brief socket of the connection */
+static int server;
+
+/** \brief sender life cycle routine */
+static void *sender (void *arg);
+
+/** \brief execution time measurement */
+static double get_delta_time(void);
+
+/** \brief print command usage */
+static void printUsage (char *cmdName);
+
+
+/**
+ *  \brief Print the results of a file, or the total.
+ *
+ *  \param title contains the first line, with the name of the file
+ *  \param count contains the results
+ */
+static void print_count(char *title, struct WordCount *count) {
+  printf("\n");
+  printf("%s\n", title);
+  printf("Total number of words = %lld\n", count->nWords);
+  printf("N. of words with an\n");
+  printf("%7s %7s %7s %7s %7s %7s\n", "A", "E", "I", "O", "U", "Y");
+  printf("%7lld %7lld %7lld %7lld %7lld %7lld\n\n", count->nWordsA, count->nWordsE, count->nWordsI, count->nWordsO, count->nWordsU, count->nWordsY);
+}
+
+
+int main(int argc, char *argv[]) {
+
+  if (argc < 2) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  // process command line arguments and set up variables
+  char *socket_path = DEFAULT_SOCKET;   // socket of the daemon
+  send_text = false;
+  int opt;                              // selected option
+
+  (void) get_delta_time ();
+
+  do {
+    switch ((opt = getopt(argc, argv, "hs:f:d:t"))) {
+      case 's': // socket
+        if (strlen(optarg) >= sizeof(((struct sockaddr_un *)0)->sun_path)) {
+          fprintf(stderr, "%s: the name of the socket is too long\n", argv[0]);
+          printUsage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        socket_path = optarg;
+        break;
+
+      case 'f': // file name
+        if (!add_named_file(&files, optarg)) {
+          fprintf(stderr, "[error] could not open the file %s\n", optarg);
+          return EXIT_FAILURE;
+        }
+        break;
+
+      case 'd': // directory tree
+        if (!add_directory(&files, optarg, 4)) {
+          fprintf(stderr, "[error] could not open the directory %s\n", optarg);
+          return EXIT_FAILURE;
+        }
+        break;
+
+      case 't': // text from the standard input
+        send_text = true;
+        break;
+
+      case 'h': // help mode
+        printUsage(argv[0]);
+        return EXIT_SUCCESS;
+
+      case '?': // invalid option
+        fprintf(stderr, "%s: invalid option\n", argv[0]);
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  } while (opt != -1);
+
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, socket_path);
+
+  if ((server = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 || connect(server, (struct sockaddr *)&address, sizeof(address)) != 0) {
+    fprintf(stderr, "[error] could not connect to the daemon at %s\n", socket_path);
+    return EXIT_FAILURE;
+  }
+
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, sender, NULL) != 0) {
+    perror("[error] on creating thread sender");
+    return EXIT_FAILURE;
+  }
+
+  // the results, as they arrive
+  FILE *results = fdopen(dup(server), "r");
+  struct WordCount total;
+  int n_results = 0;
+  bool done = false;
+  char line[MAX_LINE];
+
+  memset(&total, 0, sizeof(struct WordCount));
+  while (fgets(line, MAX_LINE, results) != NULL) {
+    struct WordCount count;
+    int name;
+
+    line[strcspn(line, "\n")] = '\0';
+    if (strcmp(line, "done") == 0) {
+      done = true;
+      break;
+    }
+
+    if (strncmp(line, "error ", 6) == 0) {
+      fprintf(stderr, "[error] the daemon could not read the file %s\n", line + 6);
+    } else if (sscanf(line, "%lld %lld %lld %lld %lld %lld %lld %n", &count.nWords, &count.nWordsA, &count.nWordsE, &count.nWordsI,
+                      &count.nWordsO, &count.nWordsU, &count.nWordsY, &name) == 7) {
+      char title[MAX_LINE + 16];
+      snprintf(title, sizeof(title), "File name: %s", strcmp(line + name, "-") == 0 ? "(standard input)" : line + name);
+      print_count(title, &count);
+      merge_counts(&total, &count);
+      n_results++;
+    }
+  }
+
+  pthread_join(thread, NULL);
+  fclose(results);
+  close(server);
+
+  if (!done) {
+    fprintf(stderr, "[error] the connection to the daemon was lost\n");
+    return EXIT_FAILURE;
+  }
+
+  if (n_results > 1) {
+    char title[32];
+    snprintf(title, sizeof(title), "Total of %d files", n_results);
+    print_count(title, &total);
+  }
+
+  float exec_time = get_delta_time();
+  printf("Execution time = %.6fs\n", exec_time);
+
+  return EXIT_SUCCESS;
+}
+
+
+/**
+ *  \brief Write all the bytes of a buffer to the socket.
+ *
+ *  \param data contains the bytes
+ *  \param n contains the number of bytes
+ */
+static void send_all(const char *data, size_t n) {
+  while (n > 0) {
+    ssize_t k = write(server, data, n);
+    if (k <= 0) return;   // the daemon went away, the reader finds it out
+    data += k;
+    n -= k;
+  }
+}
+
+/**
+ *  \brief Function sender.
+ *
+ *  Sends the files of the job, by their absolute paths since the daemon may run in
+ *  another directory, then the text of the standard input, in pieces, and the end.
+ *
+ *  \param arg not used
+ */
+static void *sender(void *arg) {
+  char line[MAX_LINE];
+  char path[PATH_MAX];
+
+  for (int i = 0; i < files.n_files; i++) {
+    char *name = realpath(files.files[i].name, path) != NULL ? path : files.files[i].name;
+    int n = snprintf(line, MAX_LINE, "file %s\n", name);
+    send_all(line, n);
+  }
+
+  if (send_text) {
+    static char buffer[64 * 1024];
+    size_t n;
+
+    while ((n = fread(buffer, 1, sizeof(buffer), stdin)) > 0) {
+      int k = snprintf(line, MAX_LINE, "text %zu\n", n);
+      send_all(line, k);
+      send_all(buffer, n);
+    }
+  }
+
+  send_all("end\n", 4);
+  return NULL;
+}
+
+
+/**
+ *  \brief Get the process time that has elapsed since last call of this time.
+ *
+ *  \return process elapsed time
+ */
+static double get_delta_time(void) {
+  static struct timespec t0, t1;
+
+  t0 = t1;
+  if(clock_gettime (CLOCK_MONOTONIC, &t1) != 0) {
+    perror ("clock_gettime");
+    exit(1);
+  }
+  return (double) (t1.tv_sec - t0.tv_sec) + 1.0e-9 * (double) (t1.tv_nsec - t0.tv_nsec);
+}
+
+
+/**
+ *  \brief Print command usage.
+ *
+ *  A message specifying how the program should be called is printed.
+ *
+ *  \param cmdName string with the name of the command
+ */
+
+static void printUsage(char *cmdName) {
+  fprintf (stderr, "\nSynopsis: %s [OPTIONS]\n"
+           "  OPTIONS:\n"
+           "  -s socket      --- set the socket of the daemon (default: " DEFAULT_SOCKET ")\n"
+           "  -f filename    --- count the words of the file (can be given more than once)\n"
+           "  -d directory   --- count the words of all the files in the directory tree (can be given more than once)\n"
+           "  -t             --- count the words of the text read from the standard input\n"
+           "  -h             --- print this help\n", cmdName);
+}
@@ -15,78 +15,6 @@
 #ifndef TEXT_PROC_Funct_H
 #define TEXT_PROC_Funct_H
 
-/**
- *  \brief Get the size of a char.
- *
- *  \param byte UTF8 encoded character
- *
- *  \return size of the read char.
- */
-int get_char_size(int byte);
-
-/**
- *  \brief Check if the char is a separation character.
- *
- *  \param val char read
- *
- *  \return true if the char is a separation char, false if not.
- */
-bool is_separation(char *val);
-
-/**
- *  \brief Checks if the given character is the vowel A.
- *
- *  \param c char read
- *
- *  \return true if the char is an 'A', false if not.
- */
-bool isVowelA(char* c);
-
-/**
- *  \brief Checks if the given character is the vowel E.
- *
- *  \param c char read
- *
- *  \return true if the char is an 'E', false if not.
- */
-bool isVowelE(char* c);
-
-/**
- *  \brief Checks if the given character is the vowel I.
- *
- *  \param c char read
- *
- *  \return true if the char is an 'I', false if not.
- */
-bool isVowelI(char* c);
-
-/**
- *  \brief Checks if the given character is the vowel O.
- *
- *  \param c char read
- *
- *  \return true if the char is an 'O', false if not.
- */
-bool isVowelO(char* c);
-
-/**
- *  \brief Checks if the given character is the vowel U.
- *
- *  \param c char read
- *
- *  \return true if the char is an 'U', false if not.
- */
-bool isVowelU(char* c);
-
-/**
- *  \brief Checks if the given character is the vowel Y.
- *
- *  \param c char read
- *
- *  \return true if the char is an 'Y', false if not.
- */
-bool isVowelY(char* c);
-
 /**
  *  \brief Performs text processing of a chunk.
  *
@@ -0,0 +1,503 @@
+/**
+ *  \file daemon.c
+ *
+ *  \brief Problem name: Text Processing with Multithreading, as a daemon.
+ *
+ *  The daemon keeps a pool of worker threads, each one with its own buffer, and
+ *  serves jobs sent over a Unix domain socket (see daemon.h), so that counting a few
+ *  small files costs neither starting a process nor creating threads.
+ *
+ *  Each connection is served by a thread of its own, so several jobs run at once:
+ *  it counts the text sent in the job itself, as it arrives, and puts the files in a
+ *  queue shared by the workers, which send the results of each file as soon as it is
+ *  counted. The results of the files are kept in a cache, by path, size and time of
+ *  the last modification, so a file that did not change is not read again.
+ *
+ *  Synchronization based on monitors: the queue of files, the cache and each job
+ *  (files still to count and writes to its socket) have their own.
+ *
+ *  \author Artur Romão e João Reis - March 2023
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
+#include <pthread.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "daemon.h"
+#include "wordCounter.h"
+
+/** \brief number of bytes of the buffer of a worker or of a connection */
+#define BUFFER_SIZE (256 * 1024)
+
+/** \brief number of entries of the cache of results */
+#define CACHE_ENTRIES 4096
+
+
+/**
+ *  \brief Structure with a job, the requests of a connection.
+ *
+ *   pending is the number of files of the job still in the queue or being counted.
+ */
+struct Job {
+  int socket;
+  int pending;
+  pthread_mutex_t lock;
+  pthread_cond_t finished;
+};
+
+/**
+ *  \brief Structure with a file to count, in the queue of the workers.
+ */
+struct Task {
+  struct Job *job;
+  char *path;
+  struct stat info;
+  struct Task *next;
+};
+
+/**
+ *  \brief Structure with the results of a file in the cache.
+ */
+struct CacheEntry {
+  char *path;
+  off_t size;
+  struct timespec mtime;
+  struct WordCount count;
+};
+
+
+/** \brief socket of the daemon */
+static char *socket_path;
+
+/** \brief first and last files of the queue */
+static struct Task *queue_head, *queue_tail;
+
+/** \brief locking flag which warrants mutual exclusion inside the monitor of the queue */
+static pthread_mutex_t accessCR = PTHREAD_MUTEX_INITIALIZER;
+
+/** \brief workers waiting for a file to count */
+static pthread_cond_t task_available = PTHREAD_COND_INITIALIZER;
+
+/** \brief cache of results, an entry per hash of the path */
+static struct CacheEntry cache[CACHE_ENTRIES];
+
+/** \brief locking flag which warrants mutual exclusion inside the monitor of the cache */
+static pthread_mutex_t cacheCR = PTHREAD_MUTEX_INITIALIZER;
+
+/** \brief worker life cycle routine */
+static void *worker (void *id);
+
+/** \brief connection life cycle routine */
+static void *connection (void *arg);
+
+/** \brief print command usage */
+static void printUsage (char *cmdName);
+
+
+/**
+ *  \brief Remove the socket when the daemon is stopped.
+ */
+static void stop(int signal) {
+  unlink(socket_path);
+  _exit(EXIT_SUCCESS);
+}
+
+
+int main(int argc, char *argv[]) {
+
+  // process command line arguments and set up variables
+  int n_workers = 4;            // number of worker threads
+  socket_path = DEFAULT_SOCKET; // socket of the daemon
+  int opt;                      // selected option
+
+  do {
+    switch ((opt = getopt(argc, argv, "hs:n:"))) {
+      case 's': // socket
+        if (strlen(optarg) >= sizeof(((struct sockaddr_un *)0)->sun_path)) {
+          fprintf(stderr, "%s: the name of the socket is too long\n", argv[0]);
+          printUsage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        socket_path = optarg;
+        break;
+
+      case 'n': // n. of workers
+        if (atoi(optarg) < 1) {
+          fprintf(stderr, "%s: number of worker threads must be greater or equal than 1\n", argv[0]);
+          printUsage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        n_workers = (int)atoi(optarg);
+        break;
+
+      case 'h': // help mode
+        printUsage(argv[0]);
+        return EXIT_SUCCESS;
+
+      case '?': // invalid option
+        fprintf(stderr, "%s: invalid option\n", argv[0]);
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  } while (opt != -1);
+
+  // a client that goes away must not stop the daemon
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, stop);
+  signal(SIGTERM, stop);
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, socket_path);
+  unlink(socket_path);   // left by a daemon that did not stop cleanly
+
+  if (listener < 0 || bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 64) != 0) {
+    perror("[error] on opening the socket");
+    return EXIT_FAILURE;
+  }
+
+  // creating worker threads, which live as long as the daemon
+  pthread_t *pthread_workers;         // workers' threads array
+  unsigned int *workers;              // workers application defined thread id array
+
+  if (((pthread_workers = malloc (n_workers * sizeof (pthread_t))) == NULL) || ((workers = malloc (n_workers * sizeof (int))) == NULL)) {
+    fprintf (stderr, "[error] on allocating space to the worker id arrays\n");
+    return EXIT_FAILURE;
+  }
+
+  for (int i = 0; i < n_workers; i++) {
+    workers[i] = i;   // add new worker with ID i
+
+    if (pthread_create(&pthread_workers[i], NULL, worker, &workers[i]) != 0) {
+      perror("[error] on creating thread worker");
+      return EXIT_FAILURE;
+    }
+  }
+
+  printf("[daemon] listening on %s with %d workers\n", socket_path, n_workers);
+  fflush(stdout);
+
+  // a thread per connection
+  while (true) {
+    int client = accept(listener, NULL, NULL);
+    if (client < 0) continue;
+
+    int *arg = (int *)malloc(sizeof(int));
+    pthread_t thread;
+    *arg = client;
+    if (pthread_create(&thread, NULL, connection, arg) != 0) {
+      perror("[error] on creating thread connection");
+      close(client);
+      free(arg);
+      continue;
+    }
+    pthread_detach(thread);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+
+/**
+ *  \brief Send a line to the client of a job.
+ *
+ *  The workers and the connection may send lines at the same time, so they are written
+ *  inside the monitor of the job.
+ *
+ *  \param job contains the job
+ *  \param format contains the format of the line, as in printf
+ */
+static void send_line(struct Job *job, const char *format, ...) {
+  char line[MAX_LINE];
+  va_list args;
+
+  va_start(args, format);
+  int n = vsnprintf(line, MAX_LINE, format, args);
+  va_end(args);
+  if (n >= MAX_LINE) n = MAX_LINE - 1;
+
+  pthread_mutex_lock(&job->lock);
+  for (int sent = 0; sent < n; ) {
+    ssize_t k = write(job->socket, line + sent, n - sent);
+    if (k <= 0) break;   // the client went away, the rest of the job is still done
+    sent += k;
+  }
+  pthread_mutex_unlock(&job->lock);
+}
+
+/**
+ *  \brief Send the results of a file (or of the text) to the client of a job.
+ *
+ *  \param job contains the job
+ *  \param path contains the path of the file, "-" for the text
+ *  \param count contains the results
+ */
+static void send_count(struct Job *job, char *path, struct WordCount *count) {
+  send_line(job, "%lld %lld %lld %lld %lld %lld %lld %s\n", count->nWords, count->nWordsA, count->nWordsE, count->nWordsI,
+            count->nWordsO, count->nWordsU, count->nWordsY, path);
+}
+
+/**
+ *  \brief Entry of the cache of a path.
+ *
+ *  \param path contains the path of the file
+ *
+ *  \return entry, which may hold the results of another path.
+ */
+static struct CacheEntry *cache_entry(char *path) {
+  unsigned int hash = 2166136261u;   // FNV-1a
+  for (char *c = path; *c != '\0'; c++) hash = (hash ^ (unsigned char)*c) * 16777619u;
+  return &cache[hash % CACHE_ENTRIES];
+}
+
+/**
+ *  \brief Look for the results of a file in the cache.
+ *
+ *  \param path contains the path of the file
+ *  \param info contains the size and time of the last modification of the file
+ *  \param count will store the results
+ *
+ *  \return true if the results of the file, as it is, were found, false otherwise.
+ */
+static bool cache_lookup(char *path, struct stat *info, struct WordCount *count) {
+  struct CacheEntry *entry = cache_entry(path);
+  bool found;
+
+  pthread_mutex_lock(&cacheCR);
+  found = entry->path != NULL && strcmp(entry->path, path) == 0 && entry->size == info->st_size &&
+          entry->mtime.tv_sec == info->st_mtim.tv_sec && entry->mtime.tv_nsec == info->st_mtim.tv_nsec;
+  if (found) *count = entry->count;
+  pthread_mutex_unlock(&cacheCR);
+
+  return found;
+}
+
+/**
+ *  \brief Keep the results of a file in the cache, in place of those of any other path.
+ *
+ *  \param path contains the path of the file
+ *  \param info contains the size and time of the last modification of the file
+ *  \param count contains the results
+ */
+static void cache_store(char *path, struct stat *info, struct WordCount *count) {
+  struct CacheEntry *entry = cache_entry(path);
+
+  pthread_mutex_lock(&cacheCR);
+  if (entry->path == NULL || strcmp(entry->path, path) != 0) {
+    free(entry->path);
+    entry->path = strdup(path);
+  }
+  entry->size = info->st_size;
+  entry->mtime = info->st_mtim;
+  entry->count = *count;
+  pthread_mutex_unlock(&cacheCR);
+}
+
+/**
+ *  \brief Put a file in the queue of the workers.
+ *
+ *  Operation carried out by the connections.
+ *
+ *  \param task contains the file
+ */
+static void put_task(struct Task *task) {
+  pthread_mutex_lock(&accessCR);
+  task->next = NULL;
+  if (queue_tail == NULL) queue_head = task;
+  else queue_tail->next = task;
+  queue_tail = task;
+  pthread_cond_signal(&task_available);
+  pthread_mutex_unlock(&accessCR);
+}
+
+/**
+ *  \brief Take a file from the queue, waiting while it is empty.
+ *
+ *  Operation carried out by the workers.
+ *
+ *  \return file to count.
+ */
+static struct Task *get_task(void) {
+  pthread_mutex_lock(&accessCR);
+  while (queue_head == NULL) pthread_cond_wait(&task_available, &accessCR);
+  struct Task *task = queue_head;
+  queue_head = task->next;
+  if (queue_head == NULL) queue_tail = NULL;
+  pthread_mutex_unlock(&accessCR);
+  return task;
+}
+
+/**
+ *  \brief Count the words of a file.
+ *
+ *  \param path contains the path of the file
+ *  \param buffer contains the buffer the file is read into
+ *  \param count will store the results
+ *
+ *  \return true if the file was read, false otherwise.
+ */
+static bool count_file(char *path, char *buffer, struct WordCount *count) {
+  struct WordCounter counter;
+  ssize_t n;
+  int fd = open(path, O_RDONLY);
+
+  if (fd < 0) return false;
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  counter_init(&counter);
+  while ((n = read(fd, buffer, BUFFER_SIZE)) > 0) counter_feed(&counter, buffer, n);
+  close(fd);
+
+  *count = counter_result(&counter);
+  return n == 0;
+}
+
+
+/**
+ *  \brief Function worker.
+ *
+ *  Forever
+ *     − to take a file from the queue
+ *     − to count its words, in the buffer of the worker
+ *     − to send the results to the client of the job and keep them in the cache.
+ *
+ *  \param id pointer to application defined worker identification
+ */
+static void *worker(void *id) {
+  char *buffer = (char *)malloc(BUFFER_SIZE);
+
+  while (true) {
+    struct Task *task = get_task();
+    struct WordCount count;
+
+    if (count_file(task->path, buffer, &count)) {
+      cache_store(task->path, &task->info, &count);
+      send_count(task->job, task->path, &count);
+    } else {
+      send_line(task->job, "error %s\n", task->path);
+    }
+
+    // the connection waits for all the files of the job
+    pthread_mutex_lock(&task->job->lock);
+    if (--task->job->pending == 0) pthread_cond_signal(&task->job->finished);
+    pthread_mutex_unlock(&task->job->lock);
+
+    free(task->path);
+    free(task);
+  }
+
+  return NULL;
+}
+
+
+/**
+ *  \brief Function connection.
+ *
+ *  Reads the requests of a job: the results of the files found in the cache are sent
+ *  at once and the other files put in the queue of the workers, while the text is
+ *  counted here. At the end of the job, waits for its files and sends the results of
+ *  the text.
+ *
+ *  \param arg pointer to the socket of the connection
+ */
+static void *connection(void *arg) {
+  struct Job job;
+  struct WordCounter text;
+  bool has_text = false;
+  char line[MAX_LINE];
+
+  job.socket = *(int *)arg;
+  job.pending = 0;
+  pthread_mutex_init(&job.lock, NULL);
+  pthread_cond_init(&job.finished, NULL);
+  free(arg);
+  counter_init(&text);
+
+  FILE *requests = fdopen(job.socket, "r");
+  char *buffer = (char *)malloc(BUFFER_SIZE);
+
+  while (fgets(line, MAX_LINE, requests) != NULL) {
+    line[strcspn(line, "\n")] = '\0';
+
+    if (strncmp(line, "file ", 5) == 0) {
+      char *path = line + 5;
+      struct stat info;
+      struct WordCount count;
+
+      if (stat(path, &info) != 0 || !S_ISREG(info.st_mode)) {
+        send_line(&job, "error %s\n", path);
+      } else if (cache_lookup(path, &info, &count)) {
+        send_count(&job, path, &count);
+      } else {
+        struct Task *task = (struct Task *)malloc(sizeof(struct Task));
+        task->job = &job;
+        task->path = strdup(path);
+        task->info = info;
+
+        pthread_mutex_lock(&job.lock);
+        job.pending++;
+        pthread_mutex_unlock(&job.lock);
+        put_task(task);
+      }
+
+    } else if (strncmp(line, "text ", 5) == 0) {
+      // the piece of the text is counted as it arrives, in the buffer of the connection
+      long long n = atoll(line + 5);
+      has_text = true;
+      while (n > 0) {
+        size_t k = fread(buffer, 1, (n < BUFFER_SIZE) ? n : BUFFER_SIZE, requests);
+        if (k == 0) break;
+        counter_feed(&text, buffer, k);
+        n -= k;
+      }
+
+    } else {
+      break;   // end of the job (or an invalid request)
+    }
+  }
+
+  // waiting for the files of the job
+  pthread_mutex_lock(&job.lock);
+  while (job.pending > 0) pthread_cond_wait(&job.finished, &job.lock);
+  pthread_mutex_unlock(&job.lock);
+
+  if (has_text) {
+    struct WordCount count = counter_result(&text);
+    send_count(&job, "-", &count);
+  }
+  send_line(&job, "done\n");
+
+  fclose(requests);
+  free(buffer);
+  pthread_mutex_destroy(&job.lock);
+  pthread_cond_destroy(&job.finished);
+  return NULL;
+}
+
+
+/**
+ *  \brief Print command usage.
+ *
+ *  A message specifying how the program should be called is printed.
+ *
+ *  \param cmdName string with the name of the command
+ */
+
+static void printUsage(char *cmdName) {
+  fprintf (stderr, "\nSynopsis: %s [OPTIONS]\n"
+           "  OPTIONS:\n"
+           "  -s socket      --- set the socket of the daemon (default: " DEFAULT_SOCKET ")\n"
+           "  -n nWorkers    --- set the number of workers (default: 4)\n"
+           "  -h             --- print this help\n", cmdName);
+}
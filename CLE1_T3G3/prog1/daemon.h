@@ -0,0 +1,30 @@
+/**
+ *  \file daemon.h (interface file)
+ *
+ *  \brief Protocol between the counting daemon and its clients.
+ *
+ *  A client connects to the Unix domain socket of the daemon and sends a job, a
+ *  request per line:
+ *     \li file <path> - count the words of a file (absolute path);
+ *     \li text <n> - followed by n bytes, count the words of a text, which may be sent
+ *     in any number of pieces (the words split between pieces are counted once);
+ *     \li end - no more requests, the connection is closed once the job is done.
+ *
+ *  The daemon answers a line per file, as soon as it is counted, and one for the text:
+ *     \li <words> <A> <E> <I> <O> <U> <Y> <path> - results of a file (path is "-" for the text);
+ *     \li error <path> - the file could not be read;
+ *  and, at last, the line "done".
+ *
+ *  \author Artur Romão e João Reis - March 2023
+ */
+
+#ifndef DAEMON_H
+#define DAEMON_H
+
+/** \brief default socket of the daemon */
+#define DEFAULT_SOCKET "/tmp/countWords.sock"
+
+/** \brief max number of bytes of a request or of a result */
+#define MAX_LINE 4200
+
+#endif /* DAEMON_H */
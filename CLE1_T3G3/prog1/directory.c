@@ -0,0 +1,218 @@
+/**
+ *  \file directory.c (implementation file)
+ *
+ *  \brief List of the files to process, given one by one or as directory trees.
+ *
+ *  Synchronization based on monitors: the queue of the directories still to be read,
+ *  the number of threads reading one and the list of files are only accessed inside
+ *  the monitor. A thread reads a whole directory outside of it and then adds its files
+ *  and subdirectories at once.
+ *
+ *  \author Artur Romão e João Reis - March 2023
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "directory.h"
+
+/** \brief list the files are added to */
+static struct FileList *file_list;
+
+/** \brief directories still to be read */
+static char **pending;
+
+/** \brief number of directories still to be read */
+static int n_pending;
+
+/** \brief capacity of the queue of directories */
+static int pending_capacity;
+
+/** \brief number of threads reading a directory */
+static int busy;
+
+/** \brief locking flag which warrants mutual exclusion inside the monitor */
+static pthread_mutex_t accessCR = PTHREAD_MUTEX_INITIALIZER;
+
+/** \brief threads waiting for a directory to read */
+static pthread_cond_t pending_changed = PTHREAD_COND_INITIALIZER;
+
+
+/**
+ *  \brief Add a file to the list.
+ *
+ *  \param list contains the list
+ *  \param name contains the name of the file
+ *  \param size contains the number of bytes of the file
+ */
+void add_file(struct FileList *list, char *name, long long size) {
+    if (list->n_files == list->capacity) {
+        list->capacity = list->capacity ? 2 * list->capacity : 64;
+        list->files = (struct FileEntry *)realloc(list->files, list->capacity * sizeof(struct FileEntry));
+        if (list->files == NULL) {
+            printf("[error] on allocating the list of files\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    list->files[list->n_files].name = name;
+    list->files[list->n_files].size = size;
+    list->n_files++;
+}
+
+/**
+ *  \brief Add a file given by its name to the list.
+ *
+ *  \param list contains the list
+ *  \param name contains the name of the file
+ *
+ *  \return true if the file exists, false otherwise.
+ */
+bool add_named_file(struct FileList *list, char *name) {
+    struct stat st;
+    if (stat(name, &st) != 0) return false;
+
+    add_file(list, name, st.st_size);
+    return true;
+}
+
+/**
+ *  \brief Add a directory to the queue, inside the monitor.
+ *
+ *  \param path contains the name of the directory
+ */
+static void push_directory(char *path) {
+    if (n_pending == pending_capacity) {
+        pending_capacity = pending_capacity ? 2 * pending_capacity : 64;
+        pending = (char **)realloc(pending, pending_capacity * sizeof(char *));
+        if (pending == NULL) {
+            printf("[error] on allocating the queue of directories\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    pending[n_pending++] = path;
+}
+
+/**
+ *  \brief Read a directory, outside of the monitor.
+ *
+ *  \param path contains the name of the directory
+ *  \param files will store the regular files of the directory
+ *  \param subdirectories will store the subdirectories of the directory
+ */
+static void read_directory(char *path, struct FileList *files, struct FileList *subdirectories) {
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        printf("[warning] could not read the directory %s\n", path);
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+
+        // the type given by readdir saves a stat of the subdirectories
+        bool is_dir = entry->d_type == DT_DIR;
+        bool is_file = entry->d_type == DT_REG;
+        struct stat st;
+        if ((is_file || entry->d_type == DT_UNKNOWN) && fstatat(dirfd(dir), entry->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+            is_dir = S_ISDIR(st.st_mode);
+            is_file = S_ISREG(st.st_mode);
+        } else if (!is_dir) {
+            continue;
+        }
+        if (!is_dir && !is_file) continue;
+
+        char *name = (char *)malloc(strlen(path) + strlen(entry->d_name) + 2);
+        sprintf(name, "%s/%s", path, entry->d_name);
+
+        if (is_dir) add_file(subdirectories, name, 0);
+        else add_file(files, name, st.st_size);
+    }
+
+    closedir(dir);
+}
+
+/**
+ *  \brief Life cycle of a thread that walks the directory trees.
+ *
+ *  While there are directories to read or threads reading one, which may add more,
+ *  takes a directory from the queue, reads it and adds its files to the list and
+ *  its subdirectories to the queue.
+ *
+ *  \param arg is not used
+ */
+static void *walker(void *arg) {
+    struct FileList files = { NULL, 0, 0 };
+    struct FileList subdirectories = { NULL, 0, 0 };
+
+    pthread_mutex_lock(&accessCR);
+    while (true) {
+        while (n_pending == 0 && busy > 0) pthread_cond_wait(&pending_changed, &accessCR);
+        if (n_pending == 0) break;
+
+        char *path = pending[--n_pending];
+        busy++;
+        pthread_mutex_unlock(&accessCR);
+
+        files.n_files = 0;
+        subdirectories.n_files = 0;
+        read_directory(path, &files, &subdirectories);
+
+        pthread_mutex_lock(&accessCR);
+        for (int i = 0; i < files.n_files; i++) add_file(file_list, files.files[i].name, files.files[i].size);
+        for (int i = 0; i < subdirectories.n_files; i++) push_directory(subdirectories.files[i].name);
+        busy--;
+        pthread_cond_broadcast(&pending_changed);
+    }
+    pthread_mutex_unlock(&accessCR);
+
+    free(files.files);
+    free(subdirectories.files);
+    return NULL;
+}
+
+/**
+ *  \brief Order of the files by name.
+ */
+static int compare_names(const void *a, const void *b) {
+    return strcmp(((struct FileEntry *)a)->name, ((struct FileEntry *)b)->name);
+}
+
+/**
+ *  \brief Add the regular files of a directory tree to the list.
+ *
+ *  \param list contains the list
+ *  \param root contains the name of the directory
+ *  \param n_threads contains the number of threads that walk the tree
+ *
+ *  \return true if the directory was read, false otherwise.
+ */
+bool add_directory(struct FileList *list, char *root, int n_threads) {
+    struct stat st;
+    if (stat(root, &st) != 0 || !S_ISDIR(st.st_mode)) return false;
+
+    int first = list->n_files;
+    file_list = list;
+    busy = 0;
+    n_pending = 0;
+    push_directory(root);
+
+    pthread_t *threads = (pthread_t *)malloc(n_threads * sizeof(pthread_t));
+    for (int i = 0; i < n_threads; i++) {
+        if (pthread_create(&threads[i], NULL, walker, NULL) != 0) {
+            perror("[error] on creating thread walker");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int i = 0; i < n_threads; i++) pthread_join(threads[i], NULL);
+    free(threads);
+
+    qsort(list->files + first, list->n_files - first, sizeof(struct FileEntry), compare_names);
+    return true;
+}
@@ -0,0 +1,69 @@
+/**
+ *  \file directory.h (interface file)
+ *
+ *  \brief List of the files to process, given one by one or as directory trees.
+ *
+ *  The directory trees are walked in parallel: a number of threads take directories
+ *  from a shared queue, add the regular files found in them to the list, with their
+ *  sizes, and the subdirectories to the queue, until it is empty and no thread is
+ *  reading a directory. Symbolic links are not followed and the files of a tree are
+ *  sorted by name, so they are listed in the same order in every run.
+ *
+ *  \author Artur Romão e João Reis - March 2023
+ */
+
+#ifndef DIRECTORY_H
+#define DIRECTORY_H
+
+#include <stdbool.h>
+
+
+/**
+ *  \brief Structure with the name and size of a file to process.
+ */
+struct FileEntry {
+  char *name;
+  long long size;
+};
+
+/**
+ *  \brief Structure with the files to process.
+ */
+struct FileList {
+  struct FileEntry *files;
+  int n_files;
+  int capacity;
+};
+
+
+/**
+ *  \brief Add a file to the list.
+ *
+ *  \param list contains the list
+ *  \param name contains the name of the file
+ *  \param size contains the number of bytes of the file
+ */
+extern void add_file(struct FileList *list, char *name, long long size);
+
+/**
+ *  \brief Add a file given by its name to the list.
+ *
+ *  \param list contains the list
+ *  \param name contains the name of the file
+ *
+ *  \return true if the file exists, false otherwise.
+ */
+extern bool add_named_file(struct FileList *list, char *name);
+
+/**
+ *  \brief Add the regular files of a directory tree to the list.
+ *
+ *  \param list contains the list
+ *  \param root contains the name of the directory
+ *  \param n_threads contains the number of threads that walk the tree
+ *
+ *  \return true if the directory was read, false otherwise.
+ */
+extern bool add_directory(struct FileList *list, char *root, int n_threads);
+
+#endif /* DIRECTORY_H */
@@ -12,8 +12,8 @@
  * 
  *  \brief Role of the main thread 
  * 
- *   1. to get the text file names by processing the command line and storing them in 
- *   the shared region
+ *   1. to get the text file names by processing the command line, walking the directory
+ *   trees given in it, and storing them in the shared region
  *
  *   2. to create the worker threads and wait for their termination
  *
@@ -29,6 +29,7 @@
 #include <pthread.h>
 #include <math.h>
 #include <time.h>
+#include <string.h>
 
 #include "shared.h"
 
@@ -63,26 +64,34 @@ int main(int argc, char *argv[]) {
 
   // process command line arguments and set up variables
   int n_workers = 4;            // number of worker threads
-  int M = 5;                    // number max of files to be processed
-  char *filenames[M];           // array with M filenames
+  char *paths[argc];            // files and directories, in the order they are given
+  bool is_directory[argc];      // whether each path is a directory
+  int n_paths = 0;              // number of files and directories
   numFiles = 0;                 // number of files to process
   maxBytesPerChunk = 4 * 1000;  // max bytes per chunk (default 4)
   int opt;                      // selected option
   all_work_done = false;        // if all work is done 
 
   do {
-    switch ((opt = getopt(argc, argv, "hf:n:m:"))) {
+    switch ((opt = getopt(argc, argv, "hf:d:n:m:i:"))) {
       case 'f': // file name
         if (optarg[0] == '-') {
           fprintf(stderr, "%s: file name is missing\n", argv[0]);
           printUsage(argv[0]);
           return EXIT_FAILURE;
         }
-        if (numFiles == M) {
-          fprintf(stderr, "%s: can only process %d files at a time\n", argv[0], M);
+        is_directory[n_paths] = false;
+        paths[n_paths++] = optarg;
+        break;
+
+      case 'd': // directory tree
+        if (optarg[0] == '-') {
+          fprintf(stderr, "%s: directory name is missing\n", argv[0]);
+          printUsage(argv[0]);
           return EXIT_FAILURE;
         }
-        filenames[numFiles++] = optarg;
+        is_directory[n_paths] = true;
+        paths[n_paths++] = optarg;
         break;
 
       case 'n': // n. of workers
@@ -103,6 +112,15 @@ int main(int argc, char *argv[]) {
         maxBytesPerChunk = (int)atoi(optarg) * 1000;
         break;
 
+      case 'i': // way of reading the files
+        if (strcmp(optarg, "uring") != 0 && strcmp(optarg, "pread") != 0) {
+          fprintf(stderr, "%s: the files must be read with uring or pread\n", argv[0]);
+          printUsage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        read_backend = strcmp(optarg, "uring") == 0 ? URING_BACKEND : PREAD_BACKEND;
+        break;
+
       case 'h': // help mode
         printUsage(argv[0]);
         return EXIT_SUCCESS;
@@ -118,8 +136,20 @@ int main(int argc, char *argv[]) {
 
   } while (opt != -1);
 
+  // start counting the execution time, the directory trees are walked by as many threads as workers
+  (void) get_delta_time ();
+
+  struct FileList files = { NULL, 0, 0 };
+  for (int i = 0; i < n_paths; i++) {
+    if (is_directory[i] ? !add_directory(&files, paths[i], n_workers) : !add_named_file(&files, paths[i])) {
+      fprintf(stderr, "[error] could not open the %s %s\n", is_directory[i] ? "directory" : "file", paths[i]);
+      return EXIT_FAILURE;
+    }
+  }
+  numFiles = files.n_files;
+
   // storing file names in the shared region
-  initialize(filenames);
+  initialize(&files);
 
   workers_status = malloc(sizeof(int) * n_workers);
   pthread_t *pthread_workers;         // workers' threads array
@@ -131,9 +161,6 @@ int main(int argc, char *argv[]) {
     return EXIT_FAILURE;
   }
 
-  // start counting the execution time
-  (void) get_delta_time ();
-
   // creating worker threads 
   for (int i = 0; i < n_workers; i++) {
     workers[i] = i;   // add new worker with ID i
@@ -177,17 +204,23 @@ static void *worker (void *worker_id) {
 
   // structure that has file's chunk to process and the results of that processing 
   struct ChunkData *chunk_data = (struct ChunkData *)malloc(sizeof(struct ChunkData));
-  chunk_data->chunk = (unsigned int *)malloc(maxBytesPerChunk * sizeof(unsigned int));
+  chunk_data->chunk = (char *)malloc(maxBytesPerChunk * sizeof(char));
 
   while (true) {
-    // get a valid text chunk
+    // get a valid text chunk, or a batch of small files
     get_chunk(id, chunk_data); 
 
-    // get result of the chunk processing
-    process_chunk(id, chunk_data);
+    if (chunk_data->is_batch) {
+      // process the files of the batch, updating their counters
+      process_batch(id, chunk_data);
 
-    // update counters
-    update_counters(id, chunk_data);
+    } else if (chunk_data->index >= 0) {
+      // get result of the chunk processing
+      process_chunk(id, chunk_data);
+
+      // update counters
+      update_counters(id, chunk_data);
+    }
 
     // reset struct variables
     reset_struct(chunk_data);
@@ -197,6 +230,7 @@ static void *worker (void *worker_id) {
   
   workers_status[id] = EXIT_SUCCESS;
 
+  free(chunk_data->chunk);
   free(chunk_data); // deallocate the structure memory
   pthread_exit(&workers_status[id]);
 } 
@@ -229,8 +263,10 @@ static double get_delta_time(void) {
 static void printUsage(char *cmdName) {
   fprintf (stderr, "\nSynopsis: %s [OPTIONS]\n"
            "  OPTIONS:\n"
-           "  -f filename    --- set the file name (max usage: 5)\n"
+           "  -f filename    --- set the file name (can be given more than once)\n"
+           "  -d directory   --- process all the files in the directory tree (can be given more than once)\n"
            "  -n nWorkers    --- set the number of workers (default: 4)\n"
            "  -m BytesChunk  --- set the number of bytes per chunk (default: 4)\n"
+           "  -i backend     --- read the files ahead with uring (io_uring) or pread (pool of threads) (default: uring)\n"
            "  -h             --- print this help\n", cmdName);
 }
\ No newline at end of file
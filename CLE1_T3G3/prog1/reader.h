@@ -0,0 +1,130 @@
+/**
+ *  \file reader.h (interface file)
+ *
+ *  \brief Asynchronous read-ahead of a file.
+ *
+ *  A reader keeps up to READ_DEPTH reads of consecutive blocks of the file in flight,
+ *  each one into its own buffer, and hands the blocks over in the order of the file as
+ *  they complete. The reads are submitted to an io_uring, with the buffers registered
+ *  in the kernel, or, where io_uring is not available, done with pread by a pool of
+ *  I/O threads shared by all readers.
+ *
+ *  A reader is not thread safe, it must be used by one thread at a time.
+ *
+ *  \author Artur Romão e João Reis - March 2023
+ */
+
+#ifndef READER_H
+#define READER_H
+
+#include <stdbool.h>
+#include <pthread.h>
+
+/** \brief number of reads of a file in flight */
+#define READ_DEPTH 8
+
+/** \brief number of bytes of a read */
+#define READ_BLOCK_SIZE (256 * 1024)
+
+
+/**
+ *  \brief Ways of reading the blocks of a file.
+ */
+enum ReadBackend { URING_BACKEND, PREAD_BACKEND };
+
+
+/**
+ *  \brief Structure with a read submitted to the pool of I/O threads.
+ */
+struct ReadRequest {
+  struct Reader *reader;
+  long long block;
+  struct ReadRequest *next;
+};
+
+
+/**
+ *  \brief Structure with the read-ahead of a file.
+ *
+ *   Block k of the file (block_size bytes from offset) is read into buffer k % READ_DEPTH
+ *   (slot), of which length bytes are expected and done bytes were read. The reader
+ *   hands over block current, at position, and keeps the block before it, so that the
+ *   last bytes taken can be given back (reader_unread); the buffer of the block before
+ *   that one is reused for the next block to read (submitted).
+ */
+struct Reader {
+  int fd;
+  long long offset;
+  long long size;
+  int block_size;
+  long long n_blocks;
+  char *buffers[READ_DEPTH];
+  int lengths[READ_DEPTH];
+  int done[READ_DEPTH];
+  bool ready[READ_DEPTH];
+  struct ReadRequest requests[READ_DEPTH];
+  int in_flight;
+  long long submitted;
+  long long current;
+  long long furthest;
+  char *block;
+  int length;
+  int position;
+  struct Ring *ring;
+  pthread_mutex_t lock;
+  pthread_cond_t completed;
+};
+
+
+/** \brief way of reading the files, io_uring unless a reader finds it is not available */
+extern enum ReadBackend read_backend;
+
+
+/**
+ *  \brief Open a file and start reading it ahead.
+ *
+ *  \param reader contains the reader
+ *  \param filename contains the name of the file
+ *  \param offset contains the position of the first byte to read
+ *  \param block_size contains the number of bytes of a read
+ *
+ *  \return true if the file was opened, false otherwise.
+ */
+extern bool open_reader(struct Reader *reader, char *filename, long long offset, int block_size);
+
+/**
+ *  \brief Read the next byte of the file.
+ *
+ *  \param reader contains the reader
+ *
+ *  \return byte read, EOF at the end of the file.
+ */
+extern int reader_getc(struct Reader *reader);
+
+/**
+ *  \brief Read the next bytes of the file.
+ *
+ *  \param reader contains the reader
+ *  \param data will store the bytes
+ *  \param n contains the number of bytes to read
+ *
+ *  \return number of bytes read, less than n only at the end of the file.
+ */
+extern long long reader_read(struct Reader *reader, void *data, long long n);
+
+/**
+ *  \brief Give back the last bytes read, which are read again next.
+ *
+ *  \param reader contains the reader
+ *  \param n contains the number of bytes, at most block_size
+ */
+extern void reader_unread(struct Reader *reader, int n);
+
+/**
+ *  \brief Close the file, once the reads in flight are over.
+ *
+ *  \param reader contains the reader
+ */
+extern void close_reader(struct Reader *reader);
+
+#endif /* READER_H */
@@ -17,13 +17,18 @@
  *  There is also a function to print out the final results, which is
  *  used after there is no more data to be processed.
  * 
+ *  The files are scheduled by size: the large ones first, largest first, split into
+ *  chunks that all workers share, and then the small ones, packed into batches of
+ *  files that a worker processes whole.
+ *
  *  Monitored Methods:
- *     \li get_chunk - operation carried out by worker threads to get a chunk of text (size = maxBytesPerChunk).
+ *     \li get_chunk - operation carried out by worker threads to get a chunk of text (size = maxBytesPerChunk) or a batch of small files.
  *     \li update_counters - operation carried out by worker threads to update the word counters each time a chunk is processed.
  *
  *  Unmonitored Methods:
  *     \li initialize - operation carried out by the main thread to allocate memory and start counters.
  *     \li process_chunk - operation carried out by the main thread to process the text chunk.
+ *     \li process_batch - operation carried out by worker threads to process a batch of small files.
  *     \li reset_struct - operation carried out by the main thread to reset the variables of the struct ChunkData.
  *     \li print_results - operation carried out by the main thread to print the final results.
  *
@@ -54,35 +59,126 @@ extern bool all_work_done;
 /** \brief storage region */
 struct File *file_data;
 
-/** \brief current file index being processed */
+/** \brief indexes of the files in the order they are processed, by decreasing size */
+static int *schedule;
+
+/** \brief number of large files, the first ones of the schedule */
+static int n_large_files;
+
+/** \brief position in the schedule of the first file of each batch of small files, and the end of the last one */
+static int *batches;
+
+/** \brief number of batches of small files */
+static int n_batches;
+
+/** \brief position in the schedule of the large file being processed */
 static int file_index = 0;
 
+/** \brief next batch of small files to process */
+static int batch_index = 0;
+
 /** \brief locking flag which warrants mutual exclusion inside the monitor */
 static pthread_mutex_t accessCR = PTHREAD_MUTEX_INITIALIZER;
 
+/**
+ *  \brief Order of the files by decreasing size.
+ */
+static int compare_sizes(const void *a, const void *b) {
+  long long size_a = (file_data + *(int *)a)->size, size_b = (file_data + *(int *)b)->size;
+  return (size_a < size_b) - (size_a > size_b);
+}
+
 /**
  *  \brief Initialize shared region
  *
- *  Store the file names.
+ *  Store the file names and schedule the files by size: the large files first, by
+ *  decreasing size, so that a large file is not left for the end, when the workers
+ *  could not share it, and then the small files, packed into batches of at most
+ *  BATCH_SIZE bytes and BATCH_FILES files.
  *
- *  \param filenames all file names passed in command argumment
+ *  \param list names and sizes of the files, passed in command argument
  */
-void initialize(char *filenames[]) {  
+void initialize(struct FileList *list) {
   // allocating memory for numFiles of file structs
   file_data = (struct File *)malloc(numFiles * sizeof(struct File));
+  schedule = (int *)malloc((numFiles + 1) * sizeof(int));
+  batches = (int *)malloc((numFiles + 1) * sizeof(int));
 
   for (int i = 0; i < numFiles; i++) {
-    (file_data + i)->file_name = filenames[i];
-    (file_data + i)->file = NULL;
-
-    file_data->nWords  = 0;
-    file_data->nWordsA = 0;
-    file_data->nWordsE = 0;
-    file_data->nWordsI = 0;
-    file_data->nWordsO = 0;
-    file_data->nWordsU = 0;
-    file_data->nWordsY = 0;
+    (file_data + i)->file_name = list->files[i].name;
+    (file_data + i)->size = list->files[i].size;
+    (file_data + i)->reader = NULL;
+
+    (file_data + i)->nWords  = 0;
+    (file_data + i)->nWordsA = 0;
+    (file_data + i)->nWordsE = 0;
+    (file_data + i)->nWordsI = 0;
+    (file_data + i)->nWordsO = 0;
+    (file_data + i)->nWordsU = 0;
+    (file_data + i)->nWordsY = 0;
+
+    schedule[i] = i;
   }
+
+  qsort(schedule, numFiles, sizeof(int), compare_sizes);
+
+  n_large_files = 0;
+  while (n_large_files < numFiles && (file_data + schedule[n_large_files])->size > SMALL_FILE_SIZE) n_large_files++;
+
+  n_batches = 0;
+  long long batch_bytes = 0;
+  for (int i = n_large_files; i < numFiles; i++) {
+    if (i == n_large_files || batch_bytes + (file_data + schedule[i])->size > BATCH_SIZE || i - batches[n_batches - 1] == BATCH_FILES) {
+      batches[n_batches++] = i;
+      batch_bytes = 0;
+    }
+    batch_bytes += (file_data + schedule[i])->size;
+  }
+  batches[n_batches] = numFiles;
+
+  // nothing to do without files
+  if (numFiles == 0) all_work_done = true;
+}
+
+/**
+ *  \brief Open a file and start reading it ahead.
+ *
+ *  \param file structure of the file
+ */
+static void open_file(struct File *file) {
+  file->reader = (struct Reader *)malloc(sizeof(struct Reader));
+
+  if (file->reader == NULL || !open_reader(file->reader, file->file_name, 0, READ_BLOCK_SIZE)) {
+    printf("[error] could not open the file %s\n", file->file_name);
+    exit(EXIT_FAILURE);
+  }
+}
+
+/**
+ *  \brief Close a file.
+ *
+ *  \param file structure of the file
+ */
+static void close_file(struct File *file) {
+  close_reader(file->reader);
+  free(file->reader);
+  file->reader = NULL;
+}
+
+/**
+ *  \brief Add the results of a chunk to the counters of a file.
+ *
+ *  \param file structure of the file
+ *  \param data structure with the results of the chunk
+ */
+static void add_counters(struct File *file, struct ChunkData *data) {
+  file->nWords  += data->nWords;
+  file->nWordsA += data->nWordsA;
+  file->nWordsE += data->nWordsE;
+  file->nWordsI += data->nWordsI;
+  file->nWordsO += data->nWordsO;
+  file->nWordsU += data->nWordsU;
+  file->nWordsY += data->nWordsY;
 }
 
 /**
@@ -102,35 +198,44 @@ void get_chunk(unsigned int id, struct ChunkData *data) {
     pthread_exit(NULL);
   }
 
-  if (!all_work_done) {
+  data->index = -1;                        // nothing to do, unless there is work left
+  data->is_batch = false;
+
+  if (!all_work_done && file_index < n_large_files) {
 
-    struct File *actual_file = (file_data + file_index);
+    struct File *actual_file = (file_data + schedule[file_index]);
 
     // if file hasn't been open yet 
-    if (actual_file->file == NULL) {
+    if (actual_file->reader == NULL) open_file(actual_file);
 
-      actual_file->file = fopen(actual_file->file_name, "rb");
-      if (actual_file->file == NULL) {
-        printf("[error] could not open the file %s\n", actual_file->file_name);
-        exit(EXIT_FAILURE);
-      }
+    // the next large file is read ahead while this one is processed
+    if (file_index + 1 < n_large_files && (file_data + schedule[file_index + 1])->reader == NULL) {
+      open_file(file_data + schedule[file_index + 1]);
     }
 
     data->is_finished = false; 
-    data->index = file_index;              // file index on the shared region array structure
+    data->index = schedule[file_index];    // file index on the shared region array structure
 
     get_valid_chunk(data, actual_file);
 
     if (data->is_finished) {
       // avançar para o próximo ficheiro
       file_index++;
-      fclose(actual_file->file); // close the file pointer
-      
-      // ou dizer ao próximo worker que já não há benfica trabalhar
-      if (numFiles == file_index) {
-        all_work_done = true;
-      }
+      close_file(actual_file);
     }
+
+  } else if (!all_work_done && batch_index < n_batches) {
+    // a batch of small files, processed whole by this worker
+    data->is_batch = true;
+    data->index = schedule[batches[batch_index]];
+    data->first = batches[batch_index];
+    data->last = batches[batch_index + 1];
+    batch_index++;
+  }
+
+  // ou dizer ao próximo worker que já não há benfica trabalhar
+  if (file_index == n_large_files && batch_index == n_batches) {
+    all_work_done = true;
   }
 
   // exit monitor
@@ -156,6 +261,32 @@ void process_chunk(unsigned int id, struct ChunkData *data) {
 }
 
 
+/**
+ *  \brief Process a batch of small files.
+ *
+ *  Operation carried out by the workers. Each file of the batch is read at once and
+ *  processed chunk by chunk, outside of the monitor, since only this worker accesses it.
+ *
+ *  \param id worker identification
+ *  \param data structure with the batch, whose chunk is used to process the files
+ */
+void process_batch(unsigned int id, struct ChunkData *data) {
+  for (int i = data->first; i < data->last; i++) {
+    struct File *file = (file_data + schedule[i]);
+    open_file(file);
+
+    do {
+      reset_struct(data);
+      get_valid_chunk(data, file);
+      count_words(data);
+      add_counters(file, data);
+    } while (!data->is_finished);
+
+    close_file(file);
+  }
+}
+
+
 /**
  *  \brief Update counter variables of the struct File.
  *
@@ -174,13 +305,7 @@ void update_counters(unsigned int id, struct ChunkData *data) {
   }
 
   // update counters
-  (file_data + data->index)->nWords  += data->nWords;
-  (file_data + data->index)->nWordsA += data->nWordsA;
-  (file_data + data->index)->nWordsE += data->nWordsE;
-  (file_data + data->index)->nWordsI += data->nWordsI;
-  (file_data + data->index)->nWordsO += data->nWordsO;
-  (file_data + data->index)->nWordsU += data->nWordsU;
-  (file_data + data->index)->nWordsY += data->nWordsY;
+  add_counters(file_data + data->index, data);
 
   // exit monitor
   if ((workers_status[id] = pthread_mutex_unlock(&accessCR)) != 0) {
@@ -203,7 +328,7 @@ void reset_struct(struct ChunkData *data) {
   // reset struct variables
   data->is_finished = false;
   data->nWords = 0; data->nWordsA = 0; data->nWordsE = 0; data->nWordsI = 0; data->nWordsO = 0; data->nWordsU = 0; data->nWordsY = 0;
-  memset(data->chunk, 0, maxBytesPerChunk * sizeof(unsigned int));
+  data->chunk_size = 0;
 }
 
 
@@ -223,4 +348,25 @@ void print_results() {
     printf("%7d %7d %7d %7d %7d %7d\n\n", (file_data + i)->nWordsA, (file_data + i)->nWordsE, (file_data + i)->nWordsI, (file_data + i)->nWordsO, (file_data + i)->nWordsU, (file_data + i)->nWordsY);
   }
 
+  if (numFiles > 1) {
+    struct File total;
+    memset(&total, 0, sizeof(struct File));
+    for (int i = 0; i < numFiles; i++) {
+      total.nWords  += (file_data + i)->nWords;
+      total.nWordsA += (file_data + i)->nWordsA;
+      total.nWordsE += (file_data + i)->nWordsE;
+      total.nWordsI += (file_data + i)->nWordsI;
+      total.nWordsO += (file_data + i)->nWordsO;
+      total.nWordsU += (file_data + i)->nWordsU;
+      total.nWordsY += (file_data + i)->nWordsY;
+    }
+
+    printf("\n");
+    printf("Total of %d files\n", numFiles);
+    printf("Total number of words = %d\n", total.nWords);
+    printf("N. of words with an\n");
+    printf("%7s %7s %7s %7s %7s %7s\n", "A", "E", "I", "O", "U", "Y");
+    printf("%7d %7d %7d %7d %7d %7d\n\n", total.nWordsA, total.nWordsE, total.nWordsI, total.nWordsO, total.nWordsU, total.nWordsY);
+  }
+
 }
\ No newline at end of file
@@ -17,13 +17,18 @@
  *  There is also a function to print out the final results, which is
  *  used after there is no more data to be processed.
  * 
+ *  The files are scheduled by size: the large ones first, largest first, split into
+ *  chunks that all workers share, and then the small ones, packed into batches of
+ *  files that a worker processes whole.
+ *
  *  Monitored Methods:
- *     \li get_chunk - operation carried out by worker threads to get a chunk of text (size = maxBytesPerChunk).
+ *     \li get_chunk - operation carried out by worker threads to get a chunk of text (size = maxBytesPerChunk) or a batch of small files.
  *     \li update_counters - operation carried out by worker threads to update the word counters each time a chunk is processed.
  *
  *  Unmonitored Methods:
  *     \li initialize - operation carried out by the main thread to allocate memory and start counters.
  *     \li process_chunk - operation carried out by the main thread to process the text chunk.
+ *     \li process_batch - operation carried out by worker threads to process a batch of small files.
  *     \li reset_struct - operation carried out by the main thread to reset the variables of the struct ChunkData.
  *     \li print_results - operation carried out by the main thread to print the final results.
  *
@@ -38,14 +43,29 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#include "reader.h"
+#include "directory.h"
+
+/** \brief files of at most SMALL_FILE_SIZE bytes are processed whole by a worker */
+#define SMALL_FILE_SIZE (64 * 1024)
+
+/** \brief number of bytes of a batch of small files */
+#define BATCH_SIZE (1024 * 1024)
+
+/** \brief number of files of a batch of small files */
+#define BATCH_FILES 256
+
 /**
  *  \brief Structure with the filename and file pointer to process.
  *
- *   It also stores the final results of the file processing.
+ *   The file is read ahead by a reader (see reader.h), opened when the file is reached
+ *   or, for the next file, while the one before it is processed. It also stores the
+ *   final results of the file processing.
  */
 struct File {
   char *file_name;
-  FILE *file;
+  long long size;
+  struct Reader *reader;
   int nWords;
   int nWordsA;
   int nWordsE;
@@ -58,12 +78,19 @@ struct File {
 /**
  *  \brief Structure with the chunk data for processing.
  *
- *   It contains the chunk results of the file processing.
+ *   It contains the chunk results of the file processing. Instead of a chunk, a
+ *   worker may get a batch of small files (is_batch), those from first to last
+ *   (exclusive) in the schedule, or nothing, if all work is done (index is -1). Only the
+ *   first chunk_size bytes of the chunk are text to process.
  */
 struct ChunkData {
   int index;
   bool is_finished;
-  unsigned int *chunk;
+  bool is_batch;
+  int first;
+  int last;
+  char *chunk;
+  int chunk_size;
   int nWords;
   int nWordsA;
   int nWordsE;
@@ -77,11 +104,11 @@ struct ChunkData {
  *  \brief Initialization of the data transfer region.
  *
  *  Allocates the memory for an array of structures with the files passed
- *  as argument and initializes it with their names.
+ *  as argument, initializes it with their names and schedules them by size.
  *
- *  \param filenames contains the names of the files to be stored
+ *  \param list contains the names and sizes of the files to be stored
  */
-extern void initialize(char *filenames[]);
+extern void initialize(struct FileList *list);
 
 /**
  *  \brief Update counter variables of the struct File.
@@ -114,6 +141,17 @@ extern void get_chunk(unsigned int id, struct ChunkData *data);
  */
 extern void process_chunk(unsigned int id, struct ChunkData *data);
 
+/**
+ *  \brief Process a batch of small files.
+ *
+ *  Operation carried out by the workers, each file of the batch is only accessed by
+ *  the worker that got it.
+ *
+ *  \param id worker identification
+ *  \param data structure with the batch, whose chunk is used to process the files
+ */
+extern void process_batch(unsigned int id, struct ChunkData *data);
+
 /**
  *  \brief Reset the variables of the struct ChunkData.
  *
@@ -126,7 +164,8 @@ extern void reset_struct(struct ChunkData *data);
 /**
  *  \brief Print results of the text processing.
  *
- *  Operation carried out by the main thread.
+ *  Operation carried out by the main thread. The results are printed per file and,
+ *  if there is more than one file, in total.
  */
 extern void print_results();
 
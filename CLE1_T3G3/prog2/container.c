@@ -0,0 +1,71 @@
+/**
+ *  \file container.c (implementation file)
+ *
+ *  \brief Sorted container: a sorted sequence of integers with a sparse block index.
+ *
+ *  The index is built from the sorted sequence in a single pass and written, with the
+ *  header and the sequence, to the container (see container.h for the layout), which
+ *  is queried by the query program.
+ *
+ *  \author Artur Romão e João Reis - March 2023
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "shared.h"
+#include "container.h"
+
+/** \brief storage region */
+extern struct File *file;
+
+
+/**
+ *  \brief Write the sorted sequence as a container.
+ *
+ *  Operation carried out by the main thread, once the sequence is sorted and validated.
+ *
+ *  \param filename contains the name of the container
+ *  \param block_size contains the number of integers of a block
+ */
+void write_container(char *filename, int block_size) {
+    if (file->type != INT32) {
+        printf("Error: the container holds 32-bit integers only\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int *sequence = (int *)file->result;
+    struct ContainerHeader header = { CONTAINER_MAGIC, block_size, file->size, ((long long)file->size + block_size - 1) / block_size };
+
+    struct BlockIndex *index = malloc((header.n_blocks > 0 ? header.n_blocks : 1) * sizeof(struct BlockIndex));
+    if (index == NULL) {
+        printf("Error allocating the index of the container\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (long long b = 0; b < header.n_blocks; b++) {
+        long long first = b * block_size;
+        long long last = first + block_size < file->size ? first + block_size - 1 : file->size - 1;
+        index[b].min = sequence[first];
+        index[b].max = sequence[last];
+        index[b].count = first;
+    }
+
+    FILE *output = fopen(filename, "wb");
+    if (output == NULL) {
+        printf("Error opening the file %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, output) == 1 &&
+                   fwrite(index, sizeof(struct BlockIndex), header.n_blocks, output) == (size_t)header.n_blocks &&
+                   fwrite(sequence, sizeof(int), file->size, output) == (size_t)file->size;
+
+    if (fclose(output) != 0 || !written) {
+        printf("Error writing the file %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    free(index);
+}
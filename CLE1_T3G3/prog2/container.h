@@ -0,0 +1,57 @@
+/**
+ *  \file container.h (interface file)
+ *
+ *  \brief Sorted container: a sorted sequence of integers with a sparse block index.
+ *
+ *  The container starts with a header (struct ContainerHeader), followed by the index,
+ *  one entry per block of block_size integers (struct BlockIndex), and by the sorted
+ *  integers. The index is small enough to stay in cache, so a query searches it and
+ *  then reads a single block of the sequence, straight from the mapped file.
+ *
+ *  \author Artur Romão e João Reis - March 2023
+ */
+
+#ifndef CONTAINER_H
+#define CONTAINER_H
+
+/** \brief first 32 bits of a container ("DSQI") */
+#define CONTAINER_MAGIC ((int)0x49515344)
+
+/** \brief number of integers of a block of the container, unless given with -b */
+#define DEFAULT_BLOCK_SIZE 256
+
+
+/**
+ *  \brief Structure with the header of a container.
+ */
+struct ContainerHeader {
+  int magic;
+  int block_size;
+  long long size;
+  long long n_blocks;
+};
+
+
+/**
+ *  \brief Structure with the entry of a block in the index.
+ *
+ *   Smallest and greatest integers of the block and number of integers before it.
+ */
+struct BlockIndex {
+  int min;
+  int max;
+  long long count;
+};
+
+
+/**
+ *  \brief Write the sorted sequence as a container.
+ *
+ *  Operation carried out by the main thread, once the sequence is sorted and validated.
+ *
+ *  \param filename contains the name of the container
+ *  \param block_size contains the number of integers of a block
+ */
+extern void write_container(char *filename, int block_size);
+
+#endif /* CONTAINER_H */
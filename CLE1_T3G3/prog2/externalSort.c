@@ -0,0 +1,583 @@
+/**
+ *  \file externalSort.c (implementation file)
+ *
+ *  \brief External sort of files larger than the memory.
+ *
+ *  The distributor goes through the following phases:
+ *
+ *   1. the file is read in runs of half the memory budget (the other half is the merge
+ *   buffer), each run is sorted by the workers with the merge tree, as the whole file
+ *   is in the in-memory sort, and written to a temporary file with a single write
+ *
+ *   2. the runs are merged, at most MAX_FAN_IN at a time, with a heap of the runs
+ *   ordered by their next integer; each run has two buffers, one being merged and the
+ *   other being filled by the reader thread, so reading overlaps with merging
+ *
+ *   3. if there are too many runs for one merge, groups of them are merged into longer
+ *   runs first; the last merge writes the header and the sorted sequence to the output,
+ *   checking its order and its fingerprint against the one of the integers read.
+ *
+ *  The temporary files are created next to the output file and removed as soon as they
+ *  are open, so nothing is left behind.
+ *
+ *  \author Artur Romão e João Reis - March 2023
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include "shared.h"
+#include "externalSort.h"
+
+/** \brief maximum number of runs merged at a time */
+#define MAX_FAN_IN 128
+
+/** \brief minimum number of integers of a run buffer, smaller buffers mean more runs are merged at a time */
+#define MIN_RUN_BUFFER_SIZE 4096
+
+/** \brief distributor threads return status */
+extern int distributor_status;
+
+/** \brief storage region */
+extern struct File *file;
+
+/** \brief reader thread return status */
+static int reader_status;
+
+/** \brief run and buffer of each block requested to the reader */
+static struct Run **requested_runs;
+static int *requested_buffers;
+
+/** \brief requests to the reader (circular queue) */
+static int first_request;
+static int n_requests;
+static int max_requests;
+
+/** \brief bool that is true when the merge is done and the reader must terminate */
+static bool merge_done;
+
+/** \brief reader synchronization point when there are no requests */
+static pthread_cond_t request_cond = PTHREAD_COND_INITIALIZER;
+
+/** \brief merge synchronization point when the next block of a run is not read yet */
+static pthread_cond_t ready_cond = PTHREAD_COND_INITIALIZER;
+
+/** \brief locking flag which warrants mutual exclusion when accessing the requests */
+static pthread_mutex_t accessCR = PTHREAD_MUTEX_INITIALIZER;
+
+
+/**
+ *  \brief Enter the monitor of the requests.
+ *
+ *  \param status contains the return status of the calling thread
+ */
+static void enter_monitor(int *status) {
+    if ((*status = pthread_mutex_lock(&accessCR)) != 0) {
+        errno = *status;                      // save error in errno
+        *status = EXIT_FAILURE;
+        perror("[error] on entering monitor(CF)");
+        pthread_exit(NULL);
+    }
+}
+
+/**
+ *  \brief Exit the monitor of the requests.
+ *
+ *  \param status contains the return status of the calling thread
+ */
+static void exit_monitor(int *status) {
+    if ((*status = pthread_mutex_unlock(&accessCR)) != 0) {
+        errno = *status;                      // save error in errno
+        *status = EXIT_FAILURE;
+        perror("[error] on exting monitor(CF)");
+        pthread_exit(NULL);
+    }
+}
+
+/**
+ *  \brief Function reader.
+ *
+ *  Role of the reader thread
+ *      • while the merge is not done
+ *          − to take the next request, blocking while there is none
+ *          − to read the block of the run into the buffer and signal that it is ready.
+ *
+ *  The requests of a run are served in order, so each run file is read sequentially.
+ *
+ *  \param arg not used
+ */
+static void *reader(void *arg) {
+    enter_monitor(&reader_status);
+
+    while (true) {
+        while (n_requests == 0 && !merge_done) {
+            if ((reader_status = pthread_cond_wait(&request_cond, &accessCR)) != 0) {
+                errno = reader_status;                          // save error in errno
+                perror("[error] on waiting for a request");
+                reader_status = EXIT_FAILURE;
+                pthread_exit(&reader_status);
+            }
+        }
+
+        if (n_requests == 0) break;
+
+        struct Run *run = requested_runs[first_request];
+        int buffer = requested_buffers[first_request];
+        first_request = (first_request + 1) % max_requests;
+        n_requests--;
+
+        exit_monitor(&reader_status);
+
+        if (fread(run->buffers[buffer], sizeof(int), run->lengths[buffer], run->file) != (size_t)run->lengths[buffer]) {
+            printf("Error reading a run\n");
+            exit(EXIT_FAILURE);
+        }
+
+        enter_monitor(&reader_status);
+
+        run->ready[buffer] = true;
+
+        if ((reader_status = pthread_cond_signal(&ready_cond)) != 0) {
+            errno = reader_status;                          // save error in errno
+            perror("[error] on signaling that a block is read");
+            reader_status = EXIT_FAILURE;
+            pthread_exit(&reader_status);
+        }
+    }
+
+    exit_monitor(&reader_status);
+
+    reader_status = EXIT_SUCCESS;
+    pthread_exit(&reader_status);
+}
+
+/**
+ *  \brief Request the next block of a run to the reader.
+ *
+ *  Operation carried out by the distributor, nothing is requested if the whole run was.
+ *
+ *  \param run contains the run
+ *  \param buffer contains the buffer of the run where the block is read to
+ *  \param buffer_size contains the number of integers of the buffer
+ */
+static void request_block(struct Run *run, int buffer, int buffer_size) {
+    if (run->scheduled == run->size) return;
+
+    enter_monitor(&distributor_status);
+
+    run->lengths[buffer] = (run->size - run->scheduled < buffer_size) ? (int)(run->size - run->scheduled) : buffer_size;
+    run->scheduled += run->lengths[buffer];
+    run->ready[buffer] = false;
+
+    requested_runs[(first_request + n_requests) % max_requests] = run;
+    requested_buffers[(first_request + n_requests) % max_requests] = buffer;
+    n_requests++;
+
+    if ((distributor_status = pthread_cond_signal(&request_cond)) != 0) {
+        errno = distributor_status;                     // save error in errno
+        perror("[error] on requesting a block");
+        distributor_status = EXIT_FAILURE;
+        pthread_exit(&distributor_status);
+    }
+
+    exit_monitor(&distributor_status);
+}
+
+/**
+ *  \brief Move on to the next block of a run.
+ *
+ *  Operation carried out by the distributor when the current block is merged: the other
+ *  buffer becomes the current one, once it is read, and the block after it is requested.
+ *
+ *  \param run contains the run
+ *  \param buffer_size contains the number of integers of the buffers
+ *
+ *  \return false if the run is merged, true otherwise.
+ */
+static bool next_block(struct Run *run, int buffer_size) {
+    run->consumed += run->lengths[run->current];
+    if (run->consumed == run->size) return false;
+
+    int merged = run->current;
+    run->current = !run->current;
+    run->position = 0;
+
+    enter_monitor(&distributor_status);
+
+    while (!run->ready[run->current]) {
+        if ((distributor_status = pthread_cond_wait(&ready_cond, &accessCR)) != 0) {
+            errno = distributor_status;                     // save error in errno
+            perror("[error] on waiting for a block");
+            distributor_status = EXIT_FAILURE;
+            pthread_exit(&distributor_status);
+        }
+    }
+
+    exit_monitor(&distributor_status);
+
+    request_block(run, merged, buffer_size);
+
+    return true;
+}
+
+/**
+ *  \brief Next integer of a run.
+ *
+ *  \param run contains the run
+ *
+ *  \return integer of the run at the current position.
+ */
+static inline int head(struct Run *run) {
+    return run->buffers[run->current][run->position];
+}
+
+/**
+ *  \brief Restore the heap property from a position down.
+ *
+ *  \param heap contains the runs, ordered by their next integer
+ *  \param heap_size contains the number of runs in the heap
+ *  \param i contains the position
+ */
+static void sift_down(struct Run **heap, int heap_size, int i) {
+    while (true) {
+        int smallest = i;
+        int left = 2 * i + 1;
+        int right = 2 * i + 2;
+
+        if (left < heap_size && head(heap[left]) < head(heap[smallest])) smallest = left;
+        if (right < heap_size && head(heap[right]) < head(heap[smallest])) smallest = right;
+        if (smallest == i) return;
+
+        struct Run *temp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = temp;
+        i = smallest;
+    }
+}
+
+/**
+ *  \brief Create a temporary file for a run.
+ *
+ *  The file is created next to the output file and removed right away, it is deleted
+ *  when it is closed.
+ *
+ *  \param output_filename contains the name of the output file
+ *
+ *  \return file pointer of the temporary file.
+ */
+static FILE *create_run_file(char *output_filename) {
+    char *template = (char *)malloc(strlen(output_filename) + 16);
+    sprintf(template, "%s.runXXXXXX", output_filename);
+
+    int fd = mkstemp(template);
+    FILE *run_file = (fd < 0) ? NULL : fdopen(fd, "w+b");
+
+    if (run_file == NULL) {
+        printf("Error creating the temporary file %s\n", template);
+        exit(EXIT_FAILURE);
+    }
+
+    unlink(template);
+    free(template);
+
+    return run_file;
+}
+
+/**
+ *  \brief Merge runs into a file.
+ *
+ *  Operation carried out by the distributor, the blocks of the runs are read ahead by
+ *  the reader thread. The runs are closed once merged.
+ *
+ *  \param runs contains the runs
+ *  \param n_runs contains the number of runs
+ *  \param output contains the file where the merged sequence is written
+ *  \param buffer_size contains the number of integers of each buffer
+ *  \param fingerprint if not NULL, the merged sequence is added to it
+ *
+ *  \return position of the first integer out of order in the merged sequence, -1 if there is none.
+ */
+static long long merge_runs(struct Run *runs, int n_runs, FILE *output, int buffer_size, struct Fingerprint *fingerprint) {
+    int *buffer_memory = (int *)malloc((2 * (size_t)n_runs + 1) * buffer_size * sizeof(int));
+    int *output_buffer = buffer_memory + 2 * (size_t)n_runs * buffer_size;
+    struct Run **heap = (struct Run **)malloc(n_runs * sizeof(struct Run *));
+    int heap_size = 0;
+
+    merge_done = false;
+    first_request = 0;
+    n_requests = 0;
+    max_requests = 2 * n_runs;
+    requested_runs = (struct Run **)malloc(max_requests * sizeof(struct Run *));
+    requested_buffers = (int *)malloc(max_requests * sizeof(int));
+
+    pthread_t pthread_reader;
+    if (pthread_create(&pthread_reader, NULL, reader, NULL) != 0) {
+        perror("[error] on creating thread reader");
+        exit(EXIT_FAILURE);
+    }
+
+    // the first two blocks of every run are requested
+    for (int i = 0; i < n_runs; i++) {
+        struct Run *run = &runs[i];
+
+        rewind(run->file);
+        run->buffers[0] = buffer_memory + (2 * (size_t)i) * buffer_size;
+        run->buffers[1] = run->buffers[0] + buffer_size;
+        run->lengths[0] = run->lengths[1] = 0;
+        run->ready[0] = run->ready[1] = true;
+        run->scheduled = 0;
+        run->consumed = 0;
+        run->current = 0;
+        run->position = 0;
+
+        request_block(run, 0, buffer_size);
+        request_block(run, 1, buffer_size);
+    }
+
+    // the runs enter the heap as their first block is read
+    for (int i = 0; i < n_runs; i++) {
+        struct Run *run = &runs[i];
+        if (run->size == 0) continue;
+
+        enter_monitor(&distributor_status);
+        while (!run->ready[0]) {
+            if ((distributor_status = pthread_cond_wait(&ready_cond, &accessCR)) != 0) {
+                errno = distributor_status;                     // save error in errno
+                perror("[error] on waiting for a block");
+                distributor_status = EXIT_FAILURE;
+                pthread_exit(&distributor_status);
+            }
+        }
+        exit_monitor(&distributor_status);
+
+        heap[heap_size++] = run;
+    }
+
+    for (int i = heap_size / 2 - 1; i >= 0; i--) {
+        sift_down(heap, heap_size, i);
+    }
+
+    // merge, the run with the smallest integer is always at the top of the heap
+    long long written = 0;
+    long long out_of_order = -1;
+    int n_output = 0;
+    int previous = INT_MIN;
+
+    while (heap_size > 0) {
+        struct Run *run = heap[0];
+        int value = head(run);
+
+        if (value < previous && out_of_order < 0) out_of_order = written + n_output - 1;
+        previous = value;
+
+        output_buffer[n_output++] = value;
+        if (n_output == buffer_size) {
+            if (fingerprint != NULL) add_to_fingerprint(fingerprint, output_buffer, n_output);
+            if (fwrite(output_buffer, sizeof(int), n_output, output) != (size_t)n_output) {
+                printf("Error writing the sorted sequence\n");
+                exit(EXIT_FAILURE);
+            }
+            written += n_output;
+            n_output = 0;
+        }
+
+        if (++run->position == run->lengths[run->current] && !next_block(run, buffer_size)) {
+            // the run is merged
+            heap[0] = heap[--heap_size];
+        }
+
+        sift_down(heap, heap_size, 0);
+    }
+
+    if (fingerprint != NULL) add_to_fingerprint(fingerprint, output_buffer, n_output);
+    if (n_output > 0 && fwrite(output_buffer, sizeof(int), n_output, output) != (size_t)n_output) {
+        printf("Error writing the sorted sequence\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // terminate the reader
+    enter_monitor(&distributor_status);
+    merge_done = true;
+    if ((distributor_status = pthread_cond_signal(&request_cond)) != 0) {
+        errno = distributor_status;                     // save error in errno
+        perror("[error] on notifying that the merge is done");
+        distributor_status = EXIT_FAILURE;
+        pthread_exit(&distributor_status);
+    }
+    exit_monitor(&distributor_status);
+
+    if (pthread_join(pthread_reader, NULL) != 0) {
+        perror("[error] on waiting for reader thread");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < n_runs; i++) {
+        fclose(runs[i].file);
+    }
+
+    free(requested_runs);
+    free(requested_buffers);
+    free(heap);
+    free(buffer_memory);
+
+    return out_of_order;
+}
+
+/**
+ *  \brief External sort of the file.
+ *
+ *  Operation carried out by the distributor. The workers sort the runs and terminate
+ *  when the last run is sorted.
+ *
+ *  \param n_workers contains the number of workers
+ *  \param memory_budget contains the number of bytes the sort may use for its buffers
+ *  \param output_filename contains the name of the file where the sorted sequence is written
+ */
+void external_sort(int n_workers, long long memory_budget, char *output_filename) {
+    long long budget = memory_budget / sizeof(int);
+
+    // phase 1: runs of half of the budget, the other half is the merge buffer of the workers
+    long long run_capacity = budget / 2;
+    if (run_capacity > INT_MAX) run_capacity = INT_MAX;
+
+    file->file = fopen(file->filename, "rb");
+    if (file->file == NULL) {
+        printf("Error opening the file\n");
+        exit(EXIT_FAILURE);
+    }
+
+    struct Header header = read_header(file->file, 0);
+    long long total = header.size;
+    read_ahead();
+
+    // the heap of the runs compares integers
+    if (header.type != INT32) {
+        printf("Error: the external sort only sorts files of 32-bit integers\n");
+        exit(EXIT_FAILURE);
+    }
+    file->type = header.type;
+    file->typed_header = header.typed;
+    file->kernels = kernels_of(INT32);
+    memset(&file->input_fingerprint, 0, sizeof(struct Fingerprint));
+    int n_runs = (int)((total + run_capacity - 1) / run_capacity);
+    struct Run *runs = (struct Run *)malloc((n_runs > 0 ? n_runs : 1) * sizeof(struct Run));
+
+    file->sequence = (int *)malloc(((total < run_capacity) ? total : run_capacity) * sizeof(int));
+
+    for (int r = 0; r < n_runs; r++) {
+        long long start = r * run_capacity;
+
+        // the run is read while the workers sort it
+        file->size = (int)((total - start < run_capacity) ? total - start : run_capacity);
+        file->loaded = 0;
+
+        divide_work(n_workers);
+        distribute_work(n_workers);
+
+        runs[r].file = create_run_file(output_filename);
+        runs[r].size = file->size;
+
+        if (fwrite(file->result, sizeof(int), file->size, runs[r].file) != (size_t)file->size) {
+            printf("Error writing a run\n");
+            exit(EXIT_FAILURE);
+        }
+
+        free(file->tasks);
+        free(file->merge_buffer);
+
+        printf("[distributor] run %d of %d sorted (%d integers)\n", r + 1, n_runs, file->size);
+    }
+
+    close_file();
+    free(file->sequence);
+
+    // the workers are not needed anymore
+    finish_work();
+
+    // phase 2 and 3: merge the runs, two buffers per run and one for the output
+    int fan_in = (int)((budget / MIN_RUN_BUFFER_SIZE - 1) / 2);
+    if (fan_in > MAX_FAN_IN) fan_in = MAX_FAN_IN;
+    if (fan_in < 2) fan_in = 2;
+
+    while (n_runs > fan_in) {
+        int n_merged = (n_runs + fan_in - 1) / fan_in;
+        int buffer_size = (int)(budget / (2 * fan_in + 1));
+        if (buffer_size < MIN_RUN_BUFFER_SIZE) buffer_size = MIN_RUN_BUFFER_SIZE;
+
+        printf("[distributor] merging %d runs into %d\n", n_runs, n_merged);
+
+        for (int g = 0; g < n_merged; g++) {
+            int first = g * fan_in;
+            int n_group = (n_runs - first < fan_in) ? n_runs - first : fan_in;
+
+            struct Run merged;
+            merged.file = create_run_file(output_filename);
+            merged.size = 0;
+            for (int i = first; i < first + n_group; i++) merged.size += runs[i].size;
+
+            merge_runs(runs + first, n_group, merged.file, buffer_size, NULL);
+
+            // the merged runs are closed, the group is replaced by its merge
+            runs[g] = merged;
+        }
+
+        n_runs = n_merged;
+    }
+
+    FILE *output = fopen(output_filename, "wb");
+    if (output == NULL) {
+        printf("Error opening the file %s\n", output_filename);
+        exit(EXIT_FAILURE);
+    }
+
+    // same header as the input
+    bool written;
+    if (header.typed) {
+        int magic = TYPED_HEADER_MAGIC;
+        int type = header.type;
+        written = fwrite(&magic, sizeof(int), 1, output) == 1 && fwrite(&type, sizeof(int), 1, output) == 1 &&
+                  fwrite(&total, sizeof(long long), 1, output) == 1;
+    } else {
+        int size = (int)total;
+        written = fwrite(&size, sizeof(int), 1, output) == 1;
+    }
+
+    if (!written) {
+        printf("Error writing the sorted sequence\n");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("[distributor] merging %d runs into %s\n", n_runs, output_filename);
+
+    long long out_of_order = -1;
+    struct Fingerprint output_fingerprint = {0, 0, 0};
+    if (n_runs > 0) {
+        int buffer_size = (int)(budget / (2 * n_runs + 1));
+        if (buffer_size < MIN_RUN_BUFFER_SIZE) buffer_size = MIN_RUN_BUFFER_SIZE;
+
+        out_of_order = merge_runs(runs, n_runs, output, buffer_size, &output_fingerprint);
+    }
+
+    if (fclose(output) != 0) {
+        printf("Error writing the sorted sequence\n");
+        exit(EXIT_FAILURE);
+    }
+
+    free(runs);
+
+    // the sorted sequence is not in memory, it was checked while it was written
+    printf("\n");
+    if (out_of_order >= 0) {
+        printf("Error in position %lld of %s\n", out_of_order, output_filename);
+    } else if (!same_fingerprint(&output_fingerprint, &file->input_fingerprint)) {
+        printf("Error: %s does not have the same integers as the file\n", output_filename);
+    } else {
+        printf("Everything is OK!\n");
+    }
+    printf("\n");
+}
@@ -0,0 +1,53 @@
+/**
+ *  \file externalSort.h (interface file)
+ *
+ *  \brief External sort of files larger than the memory.
+ *
+ *  The file is sorted in runs that fit in the memory budget, with the merge tree of the
+ *  workers, and each sorted run is written to a temporary file. The runs are then merged
+ *  into the output file while the next block of every run is read ahead by a reader thread.
+ *
+ *  \author Artur Romão e João Reis - March 2023
+ */
+
+#ifndef EXTERNAL_SORT_H
+#define EXTERNAL_SORT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+
+/**
+ *  \brief Structure with a sorted run in a temporary file.
+ *
+ *   While merging, the run is read in blocks into two buffers: the merge consumes one
+ *   of them (current) while the reader thread fills the other one. The lengths of the
+ *   blocks are set when they are requested (scheduled integers of the run) and ready
+ *   tells whether the reader has filled them.
+ */
+struct Run {
+  FILE *file;
+  long long size;
+  long long scheduled;
+  long long consumed;
+  int *buffers[2];
+  int lengths[2];
+  bool ready[2];
+  int current;
+  int position;
+};
+
+
+/**
+ *  \brief External sort of the file.
+ *
+ *  Operation carried out by the distributor. The workers sort the runs and terminate
+ *  when the last run is sorted.
+ *
+ *  \param n_workers contains the number of workers
+ *  \param memory_budget contains the number of bytes the sort may use for its buffers
+ *  \param output_filename contains the name of the file where the sorted sequence is written
+ */
+extern void external_sort(int n_workers, long long memory_budget, char *output_filename);
+
+#endif /* EXTERNAL_SORT_H */
@@ -8,6 +8,9 @@
 #include <string.h>
 
 #include "shared.h"
+#include "sampleSort.h"
+#include "externalSort.h"
+#include "container.h"
 
 /** \brief consumer threads return status array */
 int distributor_status;
@@ -15,15 +18,30 @@ int distributor_status;
 /** \brief worker threads return status array */
 int *workers_status;
 
-/** \brief queue containing the workers' ids by order of arrival (time they made a request) */
-int *waiting_work_queue;
-
-/** \brief  */
-int **work_assignment;
-
 /** \brief number of worker threads */
 int n_workers;
 
+/** \brief sort algorithm: bitonic sort and merge tree (merge) or sample sort (sample) */
+char *algorithm;
+
+/** \brief bool that is true if the subsequences are sorted by merging their natural runs (runs), false for the bitonic sort (bitonic) */
+bool natural_runs;
+
+/** \brief memory budget in bytes of the external sort, 0 to sort the file in memory */
+long long memory_budget;
+
+/** \brief file where the sorted sequence is written */
+char *output_filename;
+
+/** \brief file where the sorted container (sequence and block index) is written */
+char *container_filename;
+
+/** \brief number of integers of a block of the container */
+int block_size;
+
+/** \brief number of bytes of a record (key and payload), 0 if the file has integers */
+int record_size;
+
 /** \brief bool that is true if all work is done, false otherwise */
 bool all_work_done;
 
@@ -39,9 +57,6 @@ static double get_delta_time(void);
 /** \brief print command usage */
 static void printUsage (char *cmdName);
 
-/** \brief storage region */
-extern struct Task *tasks;
-
 
 int main(int argc, char *argv[]) {
 
@@ -52,11 +67,18 @@ int main(int argc, char *argv[]) {
 
   // process command line arguments and set up variables
   n_workers = 4;            // number of worker threads
+  algorithm = "merge";          // sort algorithm
+  natural_runs = false;         // the subsequences are sorted by the bitonic sort
+  memory_budget = 0;            // the file is sorted in memory
+  output_filename = NULL;       // the sorted sequence is not written
+  record_size = 0;              // the file has integers
+  container_filename = NULL;    // the sorted container is not written
+  block_size = DEFAULT_BLOCK_SIZE;  // integers of a block of the container
   char *filename = argv[1];     // binary file 
   int opt;                      // selected option
 
   do {
-    switch ((opt = getopt(argc, argv, "hn:"))) {
+    switch ((opt = getopt(argc, argv, "hn:a:s:m:o:r:x:b:i:"))) {
 
       case 'n': // n. of workers
         if (atoi(optarg) < 1) {
@@ -67,6 +89,68 @@ int main(int argc, char *argv[]) {
         n_workers = (int)atoi(optarg);
         break;
 
+      case 'a': // sort algorithm
+        if (strcmp(optarg, "merge") != 0 && strcmp(optarg, "sample") != 0) {
+          fprintf(stderr, "%s: sort algorithm must be merge or sample\n", argv[0]);
+          printUsage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        algorithm = optarg;
+        break;
+
+      case 's': // sort of the subsequences
+        if (strcmp(optarg, "bitonic") != 0 && strcmp(optarg, "runs") != 0) {
+          fprintf(stderr, "%s: sort of the subsequences must be bitonic or runs\n", argv[0]);
+          printUsage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        natural_runs = strcmp(optarg, "runs") == 0;
+        break;
+
+      case 'm': // memory budget of the external sort (MiB)
+        if (atoll(optarg) < 1) {
+          fprintf(stderr, "%s: memory budget must be greater or equal than 1 MiB\n", argv[0]);
+          printUsage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        memory_budget = atoll(optarg) * 1024 * 1024;
+        break;
+
+      case 'o': // output file
+        output_filename = optarg;
+        break;
+
+      case 'r': // size of the payload of the records
+        if (atoi(optarg) < 0 || atoi(optarg) % sizeof(int) != 0) {
+          fprintf(stderr, "%s: the payload of the records must be a multiple of %d bytes\n", argv[0], (int)sizeof(int));
+          printUsage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        record_size = sizeof(int) + atoi(optarg);
+        break;
+
+      case 'x': // container file
+        container_filename = optarg;
+        break;
+
+      case 'b': // size of the blocks of the container
+        if (atoi(optarg) < 1) {
+          fprintf(stderr, "%s: the blocks of the container must have at least 1 integer\n", argv[0]);
+          printUsage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        block_size = atoi(optarg);
+        break;
+
+      case 'i': // way of reading the file
+        if (strcmp(optarg, "uring") != 0 && strcmp(optarg, "pread") != 0) {
+          fprintf(stderr, "%s: the file must be read with uring or pread\n", argv[0]);
+          printUsage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        read_backend = strcmp(optarg, "uring") == 0 ? URING_BACKEND : PREAD_BACKEND;
+        break;
+
       case 'h': // help mode
         printUsage(argv[0]);
         return EXIT_SUCCESS;
@@ -82,16 +166,32 @@ int main(int argc, char *argv[]) {
 
   } while (opt != -1);
 
+  if (memory_budget > 0 && (output_filename == NULL || strcmp(algorithm, "merge") != 0)) {
+    fprintf(stderr, "%s: the external sort needs an output file and the merge algorithm\n", argv[0]);
+    printUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (record_size > 0 && (memory_budget > 0 || strcmp(algorithm, "merge") != 0)) {
+    fprintf(stderr, "%s: the records are sorted in memory with the merge algorithm\n", argv[0]);
+    printUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (container_filename != NULL && (record_size > 0 || memory_budget > 0)) {
+    fprintf(stderr, "%s: the container is written by the in-memory sort of integers\n", argv[0]);
+    printUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
   // start counting the execution time
   (void) get_delta_time ();
 
   // storing file names in the shared region
-  initialize(filename, n_workers);
+  initialize(filename, n_workers, record_size);
+  if (strcmp(algorithm, "sample") == 0) initialize_sample_sort(n_workers);
 
   workers_status     = malloc(sizeof(int) * n_workers);
-  waiting_work_queue = malloc(sizeof(int) * n_workers);
-  work_assignment    = malloc(sizeof(int) * n_workers);
-  for (int i = 0; i < n_workers; i++) waiting_work_queue[i] = -1;
 
   
   pthread_t *pthread_workers;             // workers' threads array
@@ -140,7 +240,12 @@ int main(int argc, char *argv[]) {
   } 
 
 
-  validate();
+  // the external sort checks the sequence while it writes it
+  if (memory_budget == 0) validate(n_workers);
+
+  if (container_filename != NULL) write_container(container_filename, block_size);
+
+  if (memory_budget == 0 && output_filename != NULL) write_file(output_filename);
 
   float exec_time = get_delta_time();
   printf("Execution time = %.6fs\n", exec_time);
@@ -154,45 +259,46 @@ int main(int argc, char *argv[]) {
  *
  *  Role of the worker threads
  *      • while there is work to be carried out
- *          − to request a sub-sequence of the sequence of integers
- *          − to sort it
- *          − to let the distributor thread know the work is done.
+ *          − to take a task from its deque, or steal one from another worker
+ *          − to sort a sub-sequence or merge a part of two sorted sub-sequences
+ *            (or, with records, to gather a block of them in the sorted order)
+ *          − to notify that the work is done, which makes the merges that depend on it ready.
+ *    (with the sample sort, every worker takes part in all phases of it instead)
  *
  *  \param worker_id pointer to application defined worker identification
 **/
 static void *worker (void *worker_id) {
   unsigned int id = *((unsigned int *)worker_id); // worker id
-  // // printf(">> Starting worker %d thread\n", id);
-  bool requested = false;   // flag para não estar sempre a fazer pedidos de request (apenas faz um pedido e espera)
+  struct Work work;         // work assigned to the worker
 
-  while(true) {
+  if (strcmp(algorithm, "sample") == 0) {
+    // every worker takes part in all phases of the sample sort
+    sample_sort(id);
 
-    if (!(tasks + id)->is_busy) {
-      // send a request to distributor and wait for a work assignment
-      if (!requested) {
-        request_work(id);
-        requested = true;
-      }
-
-    } else {
+    workers_status[id] = EXIT_SUCCESS;
+    pthread_exit(&workers_status[id]);
+  }
 
-      if ( strcmp((tasks + id)->type, "sort") == 0 ) {
-        // get work and sort integers
-        sort_sequence(id);
+  // blocks while there is no work available, returns false when all work is done
+  while (request_work(id, &work)) {
 
-      } else if ( strcmp((tasks + id)->type, "merge") == 0 ) {
-        // get work and merge subsequences
-        merge_sequences(id);
-      }
+    if (strcmp(work.task->type, "sort") == 0) {
+      // sort integers
+      sort_sequence(id, work.task);
 
-      // send notification to distributor that the work that has been assigned is completed
-      notify(id);
+    } else if (strcmp(work.task->type, "merge") == 0) {
+      // merge one part of two sorted subsequences
+      merge_sequences(id, work.task, work.part);
 
-      requested = false;
-      (tasks + id)->is_busy = false;
+    } else if (strcmp(work.task->type, "gather") == 0) {
+      // move one block of records to their sorted position
+      gather_records(id, work.task, work.part);
     }
-    if (all_work_done) break;
-  }   
+
+    // notify that the work is completed
+    notify(id, &work);
+  }
+
   workers_status[id] = EXIT_SUCCESS;
   pthread_exit(&workers_status[id]);
 } 
@@ -203,20 +309,36 @@ static void *worker (void *worker_id) {
  *
  *  Role of the distributor thread 
  *    • to read the sequence of integers from the binary file
- *    • to distribute sub-sequences of it to the worker threads.
+ *    • to divide it in sort tasks and build the merge tree over them
+ *    • to distribute each sort task to the worker threads as soon as its part of the file
+ *      is read and wait for the work to be done
+ *      (or, with the sample sort, to release the workers, and, with the external sort,
+ *      to do so for each run of the file and merge the sorted runs into the output file).
  *
  *  \param distributor_id pointer to application defined distributor identification
  */
 static void *distribute (void *distributor_id) {
-  unsigned int id = *((unsigned int *)distributor_id); // worker id
-  // printf(">> Starting distributor thread\n");
+  if (memory_budget > 0) {
+    // the file is sorted in runs that fit in the memory budget, which are merged into the output file
+    external_sort(n_workers, memory_budget, output_filename);
+
+  } else if (strcmp(algorithm, "sample") == 0) {
+    read_file();
 
-  read_file();
+    distribute_samples(n_workers);
 
-  divide_work(n_workers);
+  } else {
+    // the contents of the file are read while the workers sort
+    open_file();
 
-  // esperar que um worker peça trabalho
-  listen(n_workers);
+    divide_work(n_workers);
+
+    distribute_work(n_workers);
+
+    close_file();
+
+    finish_work();
+  }
 
   distributor_status = EXIT_SUCCESS;
   pthread_exit(&distributor_status);
@@ -252,5 +374,13 @@ static void printUsage(char *cmdName) {
   fprintf (stderr, "\nSynopsis: %s filename [OPTIONS]\n"
            "  OPTIONS:\n"
            "  -n nWorkers    --- set the number of workers (default: 4)\n"
+           "  -a algorithm   --- set the sort algorithm: merge or sample (default: merge)\n"
+           "  -s sort        --- set the sort of the subsequences: bitonic, or runs to merge their natural runs (default: bitonic)\n"
+           "  -m budget      --- sort the file in runs of at most budget MiB of memory and merge them (external sort)\n"
+           "  -o filename    --- write the sorted sequence to filename (needed by the external sort)\n"
+           "  -r payload     --- the file has records of an integer key and payload bytes, sorted stably by key\n"
+           "  -x filename    --- write the sorted integers with a block index to filename, to be queried by query\n"
+           "  -b blockSize   --- set the number of integers of a block of the index (default: 256)\n"
+           "  -i backend     --- read the file ahead with uring (io_uring) or pread (pool of threads) (default: uring)\n"
            "  -h             --- print this help\n", cmdName);
 }
\ No newline at end of file
@@ -0,0 +1,240 @@
+/**
+ *  \file query.c (implementation file)
+ *
+ *  \brief Queries on a sorted container written by prog2 (-x).
+ *
+ *  The container is mapped to memory, so nothing is read up front and only the index
+ *  and the block a query needs are touched. A query searches the index (binary search
+ *  on the greatest integer of each block) and then the block:
+ *
+ *      rank x       number of integers smaller than x
+ *      count a b    number of integers in [a, b]
+ *      select k     integer at position k (from 0) of the sorted sequence
+ *      contains x   whether x is in the sequence
+ *
+ *  The queries are given after the name of the container or, if there are none, read
+ *  from the standard input, one per line, and their mean latency is printed at the end.
+ *
+ *  \author Artur Romão e João Reis - March 2023
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "container.h"
+
+/** \brief header of the container */
+static struct ContainerHeader *header;
+
+/** \brief index of the container */
+static struct BlockIndex *blocks;
+
+/** \brief sorted sequence of the container */
+static int *sequence;
+
+/** \brief execution time measurement */
+static double get_delta_time(void);
+
+/** \brief print command usage */
+static void printUsage (char *cmdName);
+
+
+/**
+ *  \brief Map a container to memory.
+ *
+ *  Checks its header against the size of the file.
+ *
+ *  \param filename contains the name of the container
+ */
+static void map_container(char *filename) {
+    int fd = open(filename, O_RDONLY);
+    struct stat st;
+
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        printf("Error opening the file %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    if ((size_t)st.st_size < sizeof(struct ContainerHeader)) {
+        printf("Error: %s is not a container\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    char *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        printf("Error mapping the file %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    header = (struct ContainerHeader *)data;
+    if (header->magic != CONTAINER_MAGIC || header->block_size < 1 || header->size < 0 ||
+        header->n_blocks != (header->size + header->block_size - 1) / header->block_size ||
+        (long long)st.st_size != (long long)sizeof(struct ContainerHeader) +
+                                 header->n_blocks * (long long)sizeof(struct BlockIndex) + header->size * (long long)sizeof(int)) {
+        printf("Error: %s is not a container\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    blocks = (struct BlockIndex *)(data + sizeof(struct ContainerHeader));
+    sequence = (int *)(blocks + header->n_blocks);
+}
+
+/**
+ *  \brief Number of integers smaller than x (or not greater than x).
+ *
+ *  Finds the first block whose greatest integer is not smaller than x (greater than x)
+ *  in the index and the position of x in that block.
+ *
+ *  \param x contains the integer
+ *  \param inclusive contains true to count the integers equal to x too
+ *
+ *  \return number of integers smaller than x, or not greater than x if inclusive.
+ */
+static long long rank_of(int x, bool inclusive) {
+    long long low = 0, high = header->n_blocks;
+    while (low < high) {
+        long long mid = low + (high - low) / 2;
+        if (blocks[mid].max < x || (inclusive && blocks[mid].max == x)) low = mid + 1;
+        else high = mid;
+    }
+    if (low == header->n_blocks) return header->size;
+
+    long long first = blocks[low].count;
+    long long last = low + 1 < header->n_blocks ? blocks[low + 1].count : header->size;
+    while (first < last) {
+        long long mid = first + (last - first) / 2;
+        if (sequence[mid] < x || (inclusive && sequence[mid] == x)) first = mid + 1;
+        else last = mid;
+    }
+    return first;
+}
+
+/**
+ *  \brief Answer a query.
+ *
+ *  \param words contains the query and its arguments
+ *  \param n_words contains the number of words of the query
+ *  \param print contains true to print the answer
+ *
+ *  \return true if the query is valid, false otherwise.
+ */
+static bool answer(char **words, int n_words, bool print) {
+    if (n_words == 2 && strcmp(words[0], "rank") == 0) {
+        long long rank = rank_of(atoi(words[1]), false);
+        if (print) printf("%lld\n", rank);
+
+    } else if (n_words == 3 && strcmp(words[0], "count") == 0) {
+        int a = atoi(words[1]), b = atoi(words[2]);
+        long long count = a <= b ? rank_of(b, true) - rank_of(a, false) : 0;
+        if (print) printf("%lld\n", count);
+
+    } else if (n_words == 2 && strcmp(words[0], "select") == 0) {
+        // the blocks have the same size, so the index is not searched
+        long long k = atoll(words[1]);
+        if (k < 0 || k >= header->size) {
+            if (print) printf("out of range\n");
+        } else {
+            if (print) printf("%d\n", sequence[k]);
+        }
+
+    } else if (n_words == 2 && strcmp(words[0], "contains") == 0) {
+        int x = atoi(words[1]);
+        long long rank = rank_of(x, false);
+        bool found = rank < header->size && sequence[rank] == x;
+        if (print) printf("%s\n", found ? "yes" : "no");
+
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+
+    if (argc < 2 || strcmp(argv[1], "-h") == 0) {
+        printUsage(argv[0]);
+        return argc < 2 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    map_container(argv[1]);
+
+    // query given in the command line
+    if (argc > 2) {
+        if (!answer(argv + 2, argc - 2, true)) {
+            fprintf(stderr, "%s: invalid query\n", argv[0]);
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    // queries read from the standard input, one per line
+    char line[256];
+    long long n_queries = 0;
+    double query_time = 0;
+
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        char *words[3];
+        int n_words = 0;
+        char *word = strtok(line, " \t\n");
+        while (word != NULL && n_words < 4) {
+            if (n_words < 3) words[n_words] = word;
+            n_words++;
+            word = strtok(NULL, " \t\n");
+        }
+        if (n_words == 0) continue;
+
+        (void) get_delta_time();
+        bool valid = n_words <= 3 && answer(words, n_words, true);
+        query_time += get_delta_time();
+
+        if (!valid) printf("invalid query\n");
+        else n_queries++;
+    }
+
+    if (n_queries > 0) {
+        fprintf(stderr, "%lld queries, mean time = %.3fus\n", n_queries, query_time / n_queries * 1e6);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ *  \brief Get the process time that has elapsed since last call of this time.
+ *
+ *  \return process elapsed time
+ */
+static double get_delta_time(void) {
+    static struct timespec t0, t1;
+
+    t0 = t1;
+    if(clock_gettime (CLOCK_MONOTONIC, &t1) != 0) {
+        perror ("clock_gettime");
+        exit(1);
+    }
+    return (double) (t1.tv_sec - t0.tv_sec) + 1.0e-9 * (double) (t1.tv_nsec - t0.tv_nsec);
+}
+
+/**
+ *  \brief Print command usage.
+ *
+ *  A message specifying how the program should be called is printed.
+ *
+ *  \param cmdName string with the name of the command
+ */
+static void printUsage(char *cmdName) {
+    fprintf (stderr, "\nSynopsis: %s container [QUERY]\n"
+             "  QUERY (read from the standard input, one per line, if not given):\n"
+             "  rank x         --- number of integers smaller than x\n"
+             "  count a b      --- number of integers in [a, b]\n"
+             "  select k       --- integer at position k (from 0) of the sorted sequence\n"
+             "  contains x     --- whether x is in the sequence\n", cmdName);
+}
@@ -0,0 +1,540 @@
+/**
+ *  \file reader.c (implementation file)
+ *
+ *  \brief Asynchronous read-ahead of a file.
+ *
+ *  With io_uring, every reader has its own ring, with its buffers registered (read
+ *  with IORING_OP_READ_FIXED, or IORING_OP_READ if they can not be locked in memory).
+ *  The completions are reaped by the thread that needs a block, so there is no thread
+ *  for them. The ring is set up with the system calls, liburing is not needed.
+ *
+ *  A file of a single block is read at once with pread, when it is opened.
+ *
+ *  Without io_uring (an older kernel, or one where it is disabled), or without the
+ *  read operation it needs, the reads are queued to a pool of N_IO_THREADS threads
+ *  which read the blocks with pread and signal the reader when they are done. The
+ *  choice is made by every reader, read_backend is only set by the command line.
+ *
+ *  \author Artur Romão e João Reis - March 2023
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+#include "reader.h"
+
+/** \brief number of threads of the pool that reads with pread */
+#define N_IO_THREADS 4
+
+/** \brief way of reading the files, set before the readers are opened */
+enum ReadBackend read_backend = URING_BACKEND;
+
+
+/**
+ *  \brief Structure with an io_uring and its rings mapped to memory.
+ */
+struct Ring {
+  int fd;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  struct io_uring_sqe *sqes;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  struct io_uring_cqe *cqes;
+  void *sq_ring;
+  size_t sq_ring_size;
+  void *cq_ring;
+  size_t cq_ring_size;
+  size_t sqes_size;
+  bool fixed_buffers;
+};
+
+/** \brief reads waiting for an I/O thread */
+static struct ReadRequest *queue_head, *queue_tail;
+
+/** \brief locking flag which warrants mutual exclusion on the queue of reads */
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** \brief I/O threads waiting for a read */
+static pthread_cond_t queue_not_empty = PTHREAD_COND_INITIALIZER;
+
+/** \brief the pool of I/O threads is started once */
+static pthread_once_t pool_started = PTHREAD_ONCE_INIT;
+
+
+/**
+ *  \brief Read error, which ends the program.
+ *
+ *  \param error contains the number of the error
+ */
+static void read_error(int error) {
+    printf("Error reading the file: %s\n", strerror(error));
+    exit(EXIT_FAILURE);
+}
+
+/**
+ *  \brief Close an io_uring.
+ *
+ *  \param ring contains the ring
+ */
+static void close_ring(struct Ring *ring) {
+    munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_ring_size);
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->fd);
+    free(ring);
+}
+
+/**
+ *  \brief Check that an io_uring supports an operation.
+ *
+ *  The probe came with Linux 5.6, as IORING_OP_READ did: without it, only the
+ *  operations of the first io_uring (IORING_OP_READ_FIXED among them) are there.
+ *
+ *  \param fd contains the file descriptor of the io_uring
+ *  \param opcode contains the operation
+ *
+ *  \return true if the operation is supported, false otherwise.
+ */
+static bool supports_op(int fd, int opcode) {
+    size_t size = sizeof(struct io_uring_probe) + IORING_OP_LAST * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, size);
+
+    bool supported;
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) < 0) {
+        supported = opcode == IORING_OP_READ_FIXED;
+    } else {
+        supported = opcode <= probe->last_op && (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED);
+    }
+
+    free(probe);
+    return supported;
+}
+
+/**
+ *  \brief Set up an io_uring for the reads of a reader.
+ *
+ *  \param reader contains the reader, with its buffers allocated
+ *
+ *  \return ring, NULL if io_uring, or the read operation it needs, is not available.
+ */
+static struct Ring *setup_ring(struct Reader *reader) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    int fd = syscall(__NR_io_uring_setup, READ_DEPTH, &params);
+    if (fd < 0) return NULL;
+
+    struct Ring *ring = calloc(1, sizeof(struct Ring));
+    ring->fd = fd;
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    // with IORING_FEAT_SINGLE_MMAP both rings are in the same mapping
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) ring->sq_ring_size = ring->cq_ring_size;
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    ring->cq_ring = (params.features & IORING_FEAT_SINGLE_MMAP) ? ring->sq_ring :
+                    mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+    if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        close(fd);
+        free(ring);
+        return NULL;
+    }
+
+    ring->sq_tail = (unsigned *)((char *)ring->sq_ring + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)((char *)ring->sq_ring + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)((char *)ring->sq_ring + params.sq_off.array);
+    ring->cq_head = (unsigned *)((char *)ring->cq_ring + params.cq_off.head);
+    ring->cq_tail = (unsigned *)((char *)ring->cq_ring + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)((char *)ring->cq_ring + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)((char *)ring->cq_ring + params.cq_off.cqes);
+
+    // the buffers are registered, so the kernel does not map them on every read
+    struct iovec iovecs[READ_DEPTH];
+    int n_buffers = reader->n_blocks < READ_DEPTH ? (int)reader->n_blocks : READ_DEPTH;
+    for (int i = 0; i < n_buffers; i++) {
+        iovecs[i].iov_base = reader->buffers[i];
+        iovecs[i].iov_len = reader->block_size;
+    }
+    ring->fixed_buffers = syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, iovecs, n_buffers) == 0;
+
+    // otherwise the first read would fail with EINVAL
+    if (!supports_op(fd, ring->fixed_buffers ? IORING_OP_READ_FIXED : IORING_OP_READ)) {
+        close_ring(ring);
+        return NULL;
+    }
+
+    return ring;
+}
+
+/**
+ *  \brief Submit the rest of the read of a slot to the io_uring.
+ *
+ *  \param reader contains the reader
+ *  \param slot contains the slot
+ *  \param block contains the block read into the slot
+ */
+static void submit_to_ring(struct Reader *reader, int slot, long long block) {
+    struct Ring *ring = reader->ring;
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = ring->fixed_buffers ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = reader->fd;
+    sqe->off = reader->offset + block * reader->block_size + reader->done[slot];
+    sqe->addr = (unsigned long long)(reader->buffers[slot] + reader->done[slot]);
+    sqe->len = reader->lengths[slot] - reader->done[slot];
+    sqe->buf_index = slot;
+    sqe->user_data = block;
+
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    if (syscall(__NR_io_uring_enter, ring->fd, 1, 0, 0, NULL, 0) < 0) read_error(errno);
+}
+
+/**
+ *  \brief Reap the completed reads of the io_uring, waiting for one if there is none.
+ *
+ *  A short read is submitted again for the rest of the block.
+ *
+ *  \param reader contains the reader
+ */
+static void reap_ring(struct Reader *reader) {
+    struct Ring *ring = reader->ring;
+    unsigned head = *ring->cq_head;
+
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE) &&
+        syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR) {
+        read_error(errno);
+    }
+
+    while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+        long long block = (long long)cqe->user_data;
+        int slot = block % READ_DEPTH;
+        int res = cqe->res;
+        __atomic_store_n(ring->cq_head, ++head, __ATOMIC_RELEASE);
+
+        if (res < 0) read_error(-res);
+        if (res == 0) read_error(EIO);   // the file is shorter than it was when it was opened
+
+        reader->done[slot] += res;
+        if (reader->done[slot] < reader->lengths[slot]) {
+            submit_to_ring(reader, slot, block);
+        } else {
+            reader->ready[slot] = true;
+            reader->in_flight--;
+        }
+    }
+}
+
+/**
+ *  \brief Life cycle of an I/O thread of the pool.
+ *
+ *  Takes the next read from the queue, reads the whole block with pread and signals
+ *  the reader.
+ *
+ *  \param arg is not used
+ */
+static void *io_thread(void *arg) {
+    while (true) {
+        pthread_mutex_lock(&queue_lock);
+        while (queue_head == NULL) pthread_cond_wait(&queue_not_empty, &queue_lock);
+        struct ReadRequest *request = queue_head;
+        queue_head = request->next;
+        if (queue_head == NULL) queue_tail = NULL;
+        pthread_mutex_unlock(&queue_lock);
+
+        struct Reader *reader = request->reader;
+        int slot = request->block % READ_DEPTH;
+        long long position = reader->offset + request->block * reader->block_size;
+        int done = 0;
+
+        while (done < reader->lengths[slot]) {
+            ssize_t res = pread(reader->fd, reader->buffers[slot] + done, reader->lengths[slot] - done, position + done);
+            if (res < 0 && errno == EINTR) continue;
+            if (res < 0) read_error(errno);
+            if (res == 0) read_error(EIO);   // the file is shorter than it was when it was opened
+            done += res;
+        }
+
+        pthread_mutex_lock(&reader->lock);
+        reader->done[slot] = done;
+        reader->ready[slot] = true;
+        reader->in_flight--;
+        pthread_cond_signal(&reader->completed);
+        pthread_mutex_unlock(&reader->lock);
+    }
+    return NULL;
+}
+
+/**
+ *  \brief Start the pool of I/O threads.
+ */
+static void start_pool(void) {
+    for (int i = 0; i < N_IO_THREADS; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, io_thread, NULL) != 0) {
+            perror("[error] on creating I/O thread");
+            exit(EXIT_FAILURE);
+        }
+        pthread_detach(thread);
+    }
+}
+
+/**
+ *  \brief Submit the read of a block into its slot.
+ *
+ *  \param reader contains the reader
+ *  \param block contains the block
+ */
+static void submit(struct Reader *reader, long long block) {
+    int slot = block % READ_DEPTH;
+    long long remaining = reader->size - block * reader->block_size;
+
+    reader->lengths[slot] = remaining < reader->block_size ? (int)remaining : reader->block_size;
+    reader->done[slot] = 0;
+    reader->ready[slot] = false;
+    reader->submitted = block + 1;
+
+    if (reader->ring != NULL) {
+        reader->in_flight++;
+        submit_to_ring(reader, slot, block);
+        return;
+    }
+
+    pthread_mutex_lock(&reader->lock);
+    reader->in_flight++;
+    pthread_mutex_unlock(&reader->lock);
+
+    struct ReadRequest *request = &reader->requests[slot];
+    request->reader = reader;
+    request->block = block;
+    request->next = NULL;
+
+    pthread_mutex_lock(&queue_lock);
+    if (queue_tail == NULL) queue_head = request;
+    else queue_tail->next = request;
+    queue_tail = request;
+    pthread_cond_signal(&queue_not_empty);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+/**
+ *  \brief Wait until a slot is read.
+ *
+ *  \param reader contains the reader
+ *  \param slot contains the slot
+ */
+static void wait_for(struct Reader *reader, int slot) {
+    if (reader->ring != NULL) {
+        while (!reader->ready[slot]) reap_ring(reader);
+        return;
+    }
+
+    pthread_mutex_lock(&reader->lock);
+    while (!reader->ready[slot]) pthread_cond_wait(&reader->completed, &reader->lock);
+    pthread_mutex_unlock(&reader->lock);
+}
+
+/**
+ *  \brief Move to the next block of the file.
+ *
+ *  The first time a block is reached, the buffer of the block two blocks behind is
+ *  no longer needed and the read of the next block is submitted into it.
+ *
+ *  \param reader contains the reader
+ *
+ *  \return true if there is a next block, false at the end of the file.
+ */
+static bool next_block(struct Reader *reader) {
+    long long next = reader->current + 1;
+    if (next >= reader->n_blocks) return false;
+
+    if (next > reader->furthest) {
+        reader->furthest = next;
+        if (next >= 2 && reader->submitted < reader->n_blocks) submit(reader, reader->submitted);
+    }
+
+    int slot = next % READ_DEPTH;
+    wait_for(reader, slot);
+
+    reader->current = next;
+    reader->block = reader->buffers[slot];
+    reader->length = reader->lengths[slot];
+    reader->position = 0;
+    return true;
+}
+
+/**
+ *  \brief Open a file and start reading it ahead.
+ *
+ *  \param reader contains the reader
+ *  \param filename contains the name of the file
+ *  \param offset contains the position of the first byte to read
+ *  \param block_size contains the number of bytes of a read
+ *
+ *  \return true if the file was opened, false otherwise.
+ */
+bool open_reader(struct Reader *reader, char *filename, long long offset, int block_size) {
+    struct stat st;
+
+    memset(reader, 0, sizeof(struct Reader));
+    reader->fd = open(filename, O_RDONLY);
+    if (reader->fd < 0) return false;
+    if (fstat(reader->fd, &st) != 0) {
+        close(reader->fd);
+        return false;
+    }
+
+    reader->offset = offset;
+    reader->size = st.st_size > offset ? st.st_size - offset : 0;
+    reader->block_size = block_size;
+    reader->n_blocks = (reader->size + block_size - 1) / block_size;
+    reader->current = -1;
+    reader->furthest = -1;
+
+    // a file of a single block only needs a buffer of its size
+    if (reader->n_blocks <= 1) reader->block_size = reader->size > 0 ? (int)reader->size : 1;
+
+    // one allocation, aligned to pages, for the buffers the file needs
+    int n_buffers = reader->n_blocks < READ_DEPTH ? (reader->n_blocks > 0 ? (int)reader->n_blocks : 1) : READ_DEPTH;
+    char *buffers;
+    if (posix_memalign((void **)&buffers, 4096, (size_t)n_buffers * reader->block_size) != 0) {
+        printf("Error allocating the buffers of the file %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < n_buffers; i++) reader->buffers[i] = buffers + (size_t)i * reader->block_size;
+
+    pthread_mutex_init(&reader->lock, NULL);
+    pthread_cond_init(&reader->completed, NULL);
+
+    // a file of a single block is read at once, a ring or the pool of threads are not worth it
+    if (reader->n_blocks <= 1) {
+        while (reader->done[0] < reader->size) {
+            ssize_t res = pread(reader->fd, reader->buffers[0] + reader->done[0], reader->size - reader->done[0], offset + reader->done[0]);
+            if (res < 0 && errno == EINTR) continue;
+            if (res < 0) read_error(errno);
+            if (res == 0) read_error(EIO);
+            reader->done[0] += res;
+        }
+        reader->lengths[0] = (int)reader->size;
+        reader->ready[0] = true;
+        reader->submitted = reader->n_blocks;
+        return true;
+    }
+
+    // the fall back to the pool is decided by each reader, other threads may be opening theirs
+    if (read_backend == URING_BACKEND) reader->ring = setup_ring(reader);
+    if (reader->ring == NULL) pthread_once(&pool_started, start_pool);
+
+    // the sequential order of the file is known, so all the buffers are read ahead at once
+    posix_fadvise(reader->fd, offset, reader->size, POSIX_FADV_SEQUENTIAL);
+    while (reader->submitted < reader->n_blocks && reader->submitted < READ_DEPTH) submit(reader, reader->submitted);
+
+    return true;
+}
+
+/**
+ *  \brief Read the next byte of the file.
+ *
+ *  \param reader contains the reader
+ *
+ *  \return byte read, EOF at the end of the file.
+ */
+int reader_getc(struct Reader *reader) {
+    if (reader->position == reader->length && !next_block(reader)) return EOF;
+    return (unsigned char)reader->block[reader->position++];
+}
+
+/**
+ *  \brief Read the next bytes of the file.
+ *
+ *  \param reader contains the reader
+ *  \param data will store the bytes
+ *  \param n contains the number of bytes to read
+ *
+ *  \return number of bytes read, less than n only at the end of the file.
+ */
+long long reader_read(struct Reader *reader, void *data, long long n) {
+    long long copied = 0;
+
+    while (copied < n) {
+        if (reader->position == reader->length && !next_block(reader)) break;
+
+        long long count = reader->length - reader->position;
+        if (count > n - copied) count = n - copied;
+        memcpy((char *)data + copied, reader->block + reader->position, count);
+        reader->position += count;
+        copied += count;
+    }
+
+    return copied;
+}
+
+/**
+ *  \brief Give back the last bytes read, which are read again next.
+ *
+ *  \param reader contains the reader
+ *  \param n contains the number of bytes, at most block_size
+ */
+void reader_unread(struct Reader *reader, int n) {
+    if (n <= reader->position) {
+        reader->position -= n;
+        return;
+    }
+
+    // back to the block before, which is still in its buffer
+    n -= reader->position;
+    if (reader->current < 1 || reader->current != reader->furthest || n > reader->block_size) {
+        printf("Error: can not go back %d bytes in the file\n", n);
+        exit(EXIT_FAILURE);
+    }
+
+    reader->current--;
+    reader->block = reader->buffers[reader->current % READ_DEPTH];
+    reader->length = reader->block_size;
+    reader->position = reader->length - n;
+}
+
+/**
+ *  \brief Close the file, once the reads in flight are over.
+ *
+ *  \param reader contains the reader
+ */
+void close_reader(struct Reader *reader) {
+    if (reader->ring != NULL) {
+        while (reader->in_flight > 0) reap_ring(reader);
+        close_ring(reader->ring);
+    } else {
+        pthread_mutex_lock(&reader->lock);
+        while (reader->in_flight > 0) pthread_cond_wait(&reader->completed, &reader->lock);
+        pthread_mutex_unlock(&reader->lock);
+    }
+
+    pthread_mutex_destroy(&reader->lock);
+    pthread_cond_destroy(&reader->completed);
+    free(reader->buffers[0]);
+    close(reader->fd);
+}
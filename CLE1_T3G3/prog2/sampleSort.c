@@ -0,0 +1,291 @@
+/**
+ *  \file sampleSort.c (implementation file)
+ *
+ *  \brief Parallel sample sort.
+ *
+ *  Alternative to the merge tree, the workers go through the following phases,
+ *  separated by barriers:
+ *
+ *   1. each worker draws OVERSAMPLING samples per bucket from its block of the sequence
+ *   and one of them sorts all the samples and picks the splitters, with one equality
+ *   bucket per distinct splitter so that duplicated keys do not unbalance the buckets
+ *
+ *   2. each worker counts how many integers of its block fall in each bucket
+ *
+ *   3. from the counts of all workers (prefix sum) each worker knows where its part of
+ *   every bucket starts in the merge buffer and moves its block there
+ *
+ *   4. the buckets are sorted in their final position, taken by the workers one at a
+ *   time, so the sequence ends up sorted in the merge buffer with no merge phase.
+ *
+ *  \author Artur Romão e João Reis - March 2023
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <errno.h>
+#include <string.h>
+
+#include "shared.h"
+#include "sampleSort.h"
+
+/** \brief number of buckets per worker, more buckets than workers balance the sort phase */
+#define BUCKETS_PER_WORKER 4
+
+/** \brief number of samples drawn per bucket */
+#define OVERSAMPLING 16
+
+/** \brief worker threads return status array */
+extern int *workers_status;
+
+/** \brief bool that is true if the buckets are sorted by merging their natural runs, false for the bitonic sort */
+extern bool natural_runs;
+
+/** \brief storage region */
+extern struct File *file;
+
+/** \brief number of workers */
+static int n_threads;
+
+/** \brief synchronization point of the distributor and the workers when the sequence is read */
+static pthread_barrier_t start_barrier;
+
+/** \brief synchronization point of the workers between phases */
+static pthread_barrier_t phase_barrier;
+
+/** \brief samples drawn by the workers */
+static int *samples;
+
+/** \brief number of samples drawn by each worker */
+static int *n_samples;
+
+/** \brief distinct splitters, sorted */
+static int *splitters;
+
+/** \brief number of splitters */
+static int n_splitters;
+
+/** \brief number of buckets, one between each pair of splitters plus one for each splitter */
+static int n_buckets;
+
+/** \brief number of integers of each worker in each bucket */
+static int *bucket_counts;
+
+/** \brief position of each bucket in the merge buffer */
+static int *bucket_start;
+
+/** \brief next bucket to be sorted */
+static int next_bucket;
+
+/** \brief locking flag which warrants mutual exclusion when taking a bucket to sort */
+static pthread_mutex_t accessCR = PTHREAD_MUTEX_INITIALIZER;
+
+
+/**
+ *  \brief Initialization of the sample sort.
+ *
+ *  Operation carried out by the main thread, before the threads are created.
+ *
+ *  \param n_workers contains the number of workers
+ */
+void initialize_sample_sort(int n_workers) {
+    n_threads = n_workers;
+
+    pthread_barrier_init(&start_barrier, NULL, n_workers + 1);
+    pthread_barrier_init(&phase_barrier, NULL, n_workers);
+}
+
+/**
+ *  \brief Prepare the sample sort of the sequence read and release the workers.
+ *
+ *  Operation carried out by the distributor, after reading the file.
+ *
+ *  \param n_workers contains the number of workers
+ */
+void distribute_samples(int n_workers) {
+    int max_buckets = 2 * n_workers * BUCKETS_PER_WORKER;
+
+    // the splitters are integers
+    if (file->type != INT32) {
+        printf("Error: the sample sort only sorts files of 32-bit integers\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // the buckets are moved to this buffer and sorted there
+    file->merge_buffer = (int*)malloc(file->size * sizeof(int));
+    file->result = file->merge_buffer;
+
+    samples = (int *)malloc(n_workers * BUCKETS_PER_WORKER * OVERSAMPLING * sizeof(int));
+    n_samples = (int *)malloc(n_workers * sizeof(int));
+    splitters = (int *)malloc(n_workers * BUCKETS_PER_WORKER * sizeof(int));
+    bucket_counts = (int *)malloc(n_workers * max_buckets * sizeof(int));
+    bucket_start = (int *)malloc((max_buckets + 1) * sizeof(int));
+    next_bucket = 0;
+
+    printf("[distributor] starting the sample sort of %d integers\n", file->size);
+
+    // release the workers
+    pthread_barrier_wait(&start_barrier);
+}
+
+/**
+ *  \brief Pick the splitters from the samples of all workers.
+ *
+ *  Operation carried out by one of the workers.
+ */
+static void choose_splitters() {
+    int samples_per_worker = BUCKETS_PER_WORKER * OVERSAMPLING;
+    int n_buckets_wanted = n_threads * BUCKETS_PER_WORKER;
+
+    // gather the samples at the beginning of the array
+    int total = 0;
+    for (int i = 0; i < n_threads; i++) {
+        memmove(samples + total, samples + i * samples_per_worker, n_samples[i] * sizeof(int));
+        total += n_samples[i];
+    }
+
+    bitonicSort_int(samples, total);
+
+    // evenly spaced samples, without repetitions
+    n_splitters = 0;
+    for (int i = 1; i < n_buckets_wanted && total > 0; i++) {
+        int splitter = samples[(long long)i * total / n_buckets_wanted];
+
+        if (n_splitters == 0 || splitters[n_splitters - 1] != splitter) {
+            splitters[n_splitters++] = splitter;
+        }
+    }
+
+    n_buckets = 2 * n_splitters + 1;
+}
+
+/**
+ *  \brief Bucket of an integer.
+ *
+ *  Bucket 2i holds the integers between splitters i - 1 and i, bucket 2i + 1 holds the
+ *  integers equal to splitter i.
+ *
+ *  \param value contains the integer
+ *
+ *  \return index of the bucket.
+ */
+static int bucket_of(int value) {
+    int low = 0;
+    int high = n_splitters;
+
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+
+        if (splitters[mid] < value) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (low < n_splitters && splitters[low] == value) return 2 * low + 1;
+    return 2 * low;
+}
+
+/**
+ *  \brief Sample sort of the worker's block of the sequence.
+ *
+ *  Operation carried out by the workers, it returns when the whole sequence is sorted.
+ *
+ *  \param worker_id contains the id of the worker
+ */
+void sample_sort(int worker_id) {
+    // wait for the sequence to be read
+    pthread_barrier_wait(&start_barrier);
+
+    int *sequence = (int *)file->sequence;
+    int *buffer = (int *)file->merge_buffer;
+    int start = (int)((long long)file->size * worker_id / n_threads);
+    int end   = (int)((long long)file->size * (worker_id + 1) / n_threads);
+    int max_buckets = 2 * n_threads * BUCKETS_PER_WORKER;
+
+    // phase 1: samples of the block
+    int samples_per_worker = BUCKETS_PER_WORKER * OVERSAMPLING;
+    int *worker_samples = samples + worker_id * samples_per_worker;
+    unsigned int seed = worker_id + 1;
+
+    n_samples[worker_id] = (end > start) ? samples_per_worker : 0;
+    for (int i = 0; i < n_samples[worker_id]; i++) {
+        worker_samples[i] = sequence[start + rand_r(&seed) % (end - start)];
+    }
+
+    if (pthread_barrier_wait(&phase_barrier) == PTHREAD_BARRIER_SERIAL_THREAD) {
+        choose_splitters();
+    }
+    pthread_barrier_wait(&phase_barrier);
+
+    // phase 2: size of the worker's part of each bucket
+    int *counts = bucket_counts + worker_id * max_buckets;
+    memset(counts, 0, n_buckets * sizeof(int));
+
+    for (int i = start; i < end; i++) {
+        counts[bucket_of(sequence[i])]++;
+    }
+
+    pthread_barrier_wait(&phase_barrier);
+
+    // phase 3: prefix sum of the counts, the parts of a bucket are laid out by worker order
+    int *offsets = (int *)malloc(n_buckets * sizeof(int));
+    int position = 0;
+
+    for (int b = 0; b < n_buckets; b++) {
+        if (worker_id == 0) bucket_start[b] = position;
+
+        for (int w = 0; w < n_threads; w++) {
+            if (w == worker_id) offsets[b] = position;
+            position += bucket_counts[w * max_buckets + b];
+        }
+    }
+    if (worker_id == 0) bucket_start[n_buckets] = position;
+
+    for (int i = start; i < end; i++) {
+        buffer[offsets[bucket_of(sequence[i])]++] = sequence[i];
+    }
+    free(offsets);
+
+    printf("[worker %d] distributed %d integers over %d buckets\n", worker_id, end - start, n_buckets);
+
+    pthread_barrier_wait(&phase_barrier);
+
+    // phase 4: sort the buckets in their final position
+    int sorted_buckets = 0;
+
+    while (true) {
+        if ((workers_status[worker_id] = pthread_mutex_lock(&accessCR)) != 0) {
+            errno = workers_status[worker_id];           // save error in errno
+            workers_status[worker_id] = EXIT_FAILURE;
+            perror("[error] on entering monitor(CF)");
+            pthread_exit(NULL);
+        }
+
+        int bucket = next_bucket++;
+
+        if ((workers_status[worker_id] = pthread_mutex_unlock(&accessCR)) != 0) {
+            errno = workers_status[worker_id];           // save error in errno
+            workers_status[worker_id] = EXIT_FAILURE;
+            perror("[error] on exting monitor(CF)");
+            pthread_exit(NULL);
+        }
+
+        if (bucket >= n_buckets) break;
+
+        // the equality buckets are already sorted
+        if (bucket % 2 == 1) continue;
+
+        // the sequence is no longer used, its room is that of the merges of the runs
+        if (natural_runs) {
+            powerSort_int(buffer + bucket_start[bucket], bucket_start[bucket + 1] - bucket_start[bucket], sequence + bucket_start[bucket]);
+        } else {
+            bitonicSort_int(buffer + bucket_start[bucket], bucket_start[bucket + 1] - bucket_start[bucket]);
+        }
+        sorted_buckets++;
+    }
+
+    printf("[worker %d] sorted %d buckets\n", worker_id, sorted_buckets);
+}
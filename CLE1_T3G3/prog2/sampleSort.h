@@ -0,0 +1,43 @@
+/**
+ *  \file sampleSort.h (interface file)
+ *
+ *  \brief Parallel sample sort.
+ *
+ *  Alternative to the merge tree: the workers agree on a set of splitters drawn from
+ *  an oversampled set of the input, distribute their blocks over the buckets defined
+ *  by them and sort each bucket in its final position, so there is no merge phase.
+ *
+ *  \author Artur Romão e João Reis - March 2023
+ */
+
+#ifndef SAMPLE_SORT_H
+#define SAMPLE_SORT_H
+
+/**
+ *  \brief Initialization of the sample sort.
+ *
+ *  Operation carried out by the main thread, before the threads are created.
+ *
+ *  \param n_workers contains the number of workers
+ */
+extern void initialize_sample_sort(int n_workers);
+
+/**
+ *  \brief Prepare the sample sort of the sequence read and release the workers.
+ *
+ *  Operation carried out by the distributor, after reading the file.
+ *
+ *  \param n_workers contains the number of workers
+ */
+extern void distribute_samples(int n_workers);
+
+/**
+ *  \brief Sample sort of the worker's block of the sequence.
+ *
+ *  Operation carried out by the workers, it returns when the whole sequence is sorted.
+ *
+ *  \param worker_id contains the id of the worker
+ */
+extern void sample_sort(int worker_id);
+
+#endif /* SAMPLE_SORT_H */
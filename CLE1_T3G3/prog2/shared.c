@@ -8,11 +8,15 @@
  *  This shared region will use the array of structures initialized by
  *  the main thread.
  * 
- *  Workers can access the shared region to obtain subsequences to process from that
- *  array of structures.
+ *  The distributor divides the sequence into many sort tasks and builds the merge tree
+ *  over them, a graph of tasks where a merge only runs once both of its inputs are sorted.
+ *  Each worker owns a deque of work: it pushes and pops its own work at the bottom and,
+ *  when the deque is empty, steals work from the top of the other deques. Workers with
+ *  nothing to do block inside the monitor until work is available.
  * 
- *  There is also a function (validate) to check whether the resultant sequence is correctly sorted, 
- *  which is used when there is no more work to be carried out.
+ *  There is also a function (validate) to check whether the resultant sequence is correctly sorted
+ *  and is a permutation of the integers read (same fingerprint), which is used when there is no
+ *  more work to be carried out.
  * 
  *  \brief Role of the main thread 
  * 
@@ -31,6 +35,8 @@
 #include <pthread.h>
 #include <errno.h>
 #include <string.h>
+#include <limits.h>
+#include <sys/stat.h>
 
 #include "shared.h"
 
@@ -41,74 +47,277 @@ extern int distributor_status;
 /** \brief worker threads return status array */
 extern int *workers_status;
 
-/** \brief queue containing the workers that requested for work by order of arrival */
-extern int *waiting_work_queue;
-
 /** \brief storage region */
 struct File *file;
 
-/** \brief distributor synchronization point when a worker request work to do */
-pthread_cond_t work_request_cond;
+/** \brief deques of work of the workers */
+static struct Deque *deques;
 
-/** \brief distributor synchronization point when a worker finishes its assigned work */
-pthread_cond_t work_done_cond;
+/** \brief number of workers */
+static int n_deques;
 
-/** \brief flag to indicate if there is work to be done */
-bool work_requested;
+/** \brief number of pieces of work in the deques */
+static int pending_work;
 
-/** \brief last index of waiting queue */
-int index_waiting_queue;
+/** \brief workers synchronization point when there is no work available */
+static pthread_cond_t work_available_cond;
 
-/** \brief check if queue is empty */
-bool empty_queue = true;
+/** \brief distributor synchronization point when the sort is done */
+static pthread_cond_t work_done_cond;
 
-/** \brief array of tasks assigned to the workers */
-struct Task *tasks;
+/** \brief bool that is true if the sort distributed last is done, false otherwise */
+static bool sort_done;
 
-/** \brief bool that is true if all work is done, false otherwise */
+/** \brief bool that is true if there are no more sorts to distribute, false otherwise */
 extern bool all_work_done;
 
+/** \brief bool that is true if the subsequences are sorted by merging their natural runs, false for the bitonic sort */
+extern bool natural_runs;
+
 /** \brief locking flag which warrants mutual exclusion inside the monitor */
 static pthread_mutex_t accessCR = PTHREAD_MUTEX_INITIALIZER;
 
+/** \brief number of sort tasks per worker, more tasks than workers balance the load */
+#define SORT_TASKS_PER_WORKER 8
+
+/** \brief minimum number of elements of a sort task */
+#define MIN_SORT_TASK_SIZE 1024
+
+/** \brief minimum number of elements of a merge part, smaller merges are split in fewer parts */
+#define MIN_MERGE_PART_SIZE 1024
+
+/** \brief number of integers read from the file at a time */
+#define LOAD_BLOCK_SIZE (1 << 20)
+
+/** \brief number of bytes of a block of the sorted records, it should fit in the cache */
+#define GATHER_BLOCK_BYTES (256 * 1024)
+
+/** \brief minimum number of elements of a natural run, shorter runs are extended by insertion sort */
+#define MIN_RUN 32
+
+
+/* kernels of the integers */
+#define ELEMENT int
+#define KERNEL(name) name##_int
+#include "sortKernels.h"
+#undef ELEMENT
+#undef KERNEL
+
+/* kernels of the unsigned integers and of the transformed floats */
+#define ELEMENT unsigned int
+#define KERNEL(name) name##_u32
+#include "sortKernels.h"
+#undef ELEMENT
+#undef KERNEL
+
+/* kernels of the 64-bit integers */
+#define ELEMENT long long
+#define KERNEL(name) name##_i64
+#include "sortKernels.h"
+#undef ELEMENT
+#undef KERNEL
+
+/* kernels of the 64-bit unsigned integers, of the transformed doubles and of the (key, index) pairs of the records */
+#define ELEMENT unsigned long long
+#define KERNEL(name) name##_u64
+#include "sortKernels.h"
+#undef ELEMENT
+#undef KERNEL
+
 
 /**
  *  \brief Initialize shared region
  *
- *  Store the file names.
+ *  Store the file name and initialize the deques of the workers.
  *
- *  \param filename all file names passed in command argumment
+ *  \param filename file name passed in command argumment
+ *  \param n_workers number of workers
+ *  \param record_size number of bytes of a record, 0 if the file has integers
  */
-void initialize(char *file_name, int n_workers) {  
+void initialize(char *file_name, int n_workers, int record_size) {  
   // allocating memory file structs
   file = (struct File*)malloc(sizeof(struct File));
 
   file->filename = file_name;
   file->file = NULL;
+  file->record_size = record_size;
+  file->records = NULL;
+  file->sorted_records = NULL;
 
-  pthread_cond_init (&work_request_cond, NULL);    // initialize work_request synchronization point 
+  pthread_cond_init (&work_available_cond, NULL);  // initialize work_available synchronization point
   pthread_cond_init (&work_done_cond, NULL);       // initialize work_done synchronization point
 
-  work_requested = false;
-  index_waiting_queue = 0;
+  pending_work = 0;
+  sort_done = false;
   all_work_done = false;
 
-  // initialize storage struct for tasks 
-  tasks = (struct Task *)malloc(n_workers * sizeof(struct Task));
+  // initialize the deques of work
+  n_deques = n_workers;
+  deques = (struct Deque *)malloc(n_workers * sizeof(struct Deque));
 
   for (int i = 0; i < n_workers; i++) {
-    (tasks + i)->worker_id = i;
-    (tasks + i)->is_busy   = false;
+    (deques + i)->capacity = 64;
+    (deques + i)->work = (struct Work *)malloc((deques + i)->capacity * sizeof(struct Work));
+    (deques + i)->top = 0;
+    (deques + i)->bottom = 0;
+    pthread_mutex_init(&(deques + i)->lock, NULL);
   }
 }
 
 /**
- *  \brief Read the file.
+ *  \brief Kernels of a type of element.
  *
- *  Reads a binary file and stores its content in an array of integers.
+ *  \param type contains the type of the elements
  *
+ *  \return kernels that sort the elements (or their keys, for floating-point numbers).
  */
-void read_file() {
+struct Kernels *kernels_of(enum ElementType type) {
+    switch (type) {
+        case INT32:   return &kernels_int;
+        case UINT32:  return &kernels_u32;
+        case INT64:   return &kernels_i64;
+        case UINT64:  return &kernels_u64;
+        case FLOAT32: return &kernels_u32;
+        case FLOAT64: return &kernels_u64;
+    }
+    return NULL;
+}
+
+/**
+ *  \brief Size of an element of the sequence.
+ *
+ *  \return number of bytes of an element, or of a (key, index) pair if the file has records.
+ */
+static size_t element_size() {
+    return file->kernels->element_size;
+}
+
+/**
+ *  \brief Transform floating-point numbers into keys with the same total order.
+ *
+ *  The sign bit of the positive numbers is set and all the bits of the negative ones are
+ *  flipped, so the keys, as unsigned integers, are in the order -NaN, -inf, negative
+ *  numbers, -0, +0, positive numbers, +inf and NaN. Other types are their own keys.
+ *
+ *  \param values contains the elements
+ *  \param n contains the number of elements
+ */
+static void to_keys(void *values, int n) {
+    if (file->type == FLOAT32) {
+        unsigned int *keys = (unsigned int *)values;
+        for (int i = 0; i < n; i++) keys[i] ^= (keys[i] >> 31) ? 0xffffffffu : 0x80000000u;
+
+    } else if (file->type == FLOAT64) {
+        unsigned long long *keys = (unsigned long long *)values;
+        for (int i = 0; i < n; i++) keys[i] ^= (keys[i] >> 63) ? ~0ULL : 0x8000000000000000ULL;
+    }
+}
+
+/**
+ *  \brief Transform keys back into the floating-point numbers they came from.
+ *
+ *  \param values contains the keys
+ *  \param n contains the number of keys
+ */
+static void from_keys(void *values, int n) {
+    if (file->type == FLOAT32) {
+        unsigned int *keys = (unsigned int *)values;
+        for (int i = 0; i < n; i++) keys[i] ^= (keys[i] >> 31) ? 0x80000000u : 0xffffffffu;
+
+    } else if (file->type == FLOAT64) {
+        unsigned long long *keys = (unsigned long long *)values;
+        for (int i = 0; i < n; i++) keys[i] ^= (keys[i] >> 63) ? 0x8000000000000000ULL : ~0ULL;
+    }
+}
+
+/**
+ *  \brief Print an element of the sequence.
+ *
+ *  \param values contains the elements (keys, for floating-point numbers)
+ *  \param i contains the position of the element
+ */
+static void print_element(void *values, int i) {
+    union { int i32; unsigned int u32; long long i64; unsigned long long u64; float f32; double f64; } element;
+
+    memcpy(&element, (char *)values + i * element_size(), element_size());
+    from_keys(&element, 1);
+
+    switch (file->type) {
+        case INT32:   printf("%d", element.i32); break;
+        case UINT32:  printf("%u", element.u32); break;
+        case INT64:   printf("%lld", element.i64); break;
+        case UINT64:  printf("%llu", element.u64); break;
+        case FLOAT32: printf("%g", element.f32); break;
+        case FLOAT64: printf("%g", element.f64); break;
+    }
+}
+
+/**
+ *  \brief Read the header of a binary file.
+ *
+ *  Reads the type and the number of elements (or records) of the file and checks them
+ *  against the size of the file.
+ *
+ *  \param file_pointer contains the file, positioned at its beginning
+ *  \param record_size contains the number of bytes of a record, 0 if the file has no records
+ *
+ *  \return header of the file.
+ */
+struct Header read_header(FILE *file_pointer, int record_size) {
+    struct Header header;
+    int first;
+    long long size;
+    long long header_size = sizeof(int);
+
+    if (fread(&first, sizeof(int), 1, file_pointer) != 1) {
+        printf("Error reading the file\n");
+        exit(EXIT_FAILURE);
+    }
+
+    header.typed = (first == TYPED_HEADER_MAGIC && record_size == 0);
+    header.type = INT32;
+    size = first;
+
+    if (header.typed) {
+        // type of the elements and 64-bit number of elements
+        int type;
+        if (fread(&type, sizeof(int), 1, file_pointer) != 1 || fread(&size, sizeof(long long), 1, file_pointer) != 1) {
+            printf("Error reading the file\n");
+            exit(EXIT_FAILURE);
+        }
+
+        if (type < INT32 || type > FLOAT64) {
+            printf("Error: unknown type of elements (%d) in the header of the file\n", type);
+            exit(EXIT_FAILURE);
+        }
+
+        header.type = (enum ElementType)type;
+        header_size += sizeof(int) + sizeof(long long);
+    }
+
+    long long item_size = record_size ? record_size : (long long)kernels_of(header.type)->element_size;
+
+    // the header must match the number of elements in the file
+    struct stat st;
+    if (fstat(fileno(file_pointer), &st) != 0 || size < 0 ||
+        (long long)st.st_size != header_size + item_size * size) {
+        printf("Error: the header of the file (%lld elements) does not match its size\n", size);
+        exit(EXIT_FAILURE);
+    }
+
+    header.size = size;
+
+    return header;
+}
+
+/**
+ *  \brief Open the file.
+ *
+ *  Reads the header of a binary file, checks it against the size of the file and
+ *  allocates the array of integers. The contents are read by read_block.
+ *
+ */
+void open_file() {
     // Open binary file for reading
     file->file = fopen(file->filename, "rb");
     
@@ -118,162 +327,405 @@ void read_file() {
     }
 
     // Read the header of the binary file
-    if (fread(&file->size, sizeof(int), 1, file->file) != 1) {
-        printf("Error reading the file\n");
+    struct Header header = read_header(file->file, file->record_size);
+
+    // the external sort takes any number of integers, a file sorted in memory is indexed by int
+    if (header.size > INT_MAX) {
+        printf("Error: the file has %lld elements, more than can be sorted in memory (see -m)\n", header.size);
+        exit(EXIT_FAILURE);
+    }
+    file->size = (int)header.size;
+    file->type = header.type;
+    file->typed_header = header.typed;
+    read_ahead();
+
+    // the (key, index) pairs of the records are 64-bit unsigned integers
+    file->kernels = kernels_of(file->record_size ? UINT64 : file->type);
+
+    file->sequence = malloc(file->size * element_size());
+    if (file->record_size) file->records = (char *)malloc((size_t)file->size * file->record_size);
+    file->loaded = 0;
+    memset(&file->input_fingerprint, 0, sizeof(struct Fingerprint));
+}
+
+/**
+ *  \brief Start reading the elements of the file ahead.
+ *
+ *  The elements, from the end of the header, are read by a reader (see reader.h)
+ *  instead of the file pointer, which is closed.
+ */
+void read_ahead() {
+    long long header_size = ftell(file->file);
+    fclose(file->file);
+    file->file = NULL;
+
+    if (!open_reader(&file->reader, file->filename, header_size, READ_BLOCK_SIZE)) {
+        printf("Error opening the file\n");
         exit(EXIT_FAILURE);
     }
+}
+
+/**
+ *  \brief Read a block of the file.
+ *
+ *  Copies the next LOAD_BLOCK_SIZE elements (at most), read ahead by the reader, into the
+ *  array of elements, until size elements are loaded, transforms floating-point numbers into their
+ *  keys and adds them to the fingerprint of the input while they are in the cache.
+ *
+ *  \return number of integers read so far.
+ */
+int read_block() {
+    int count = file->size - file->loaded;
+    if (count > LOAD_BLOCK_SIZE) count = LOAD_BLOCK_SIZE;
+
+    if (file->record_size == 0) {
+        char *sequence = (char *)file->sequence + file->loaded * element_size();
 
-    file->sequence = (int*)malloc(file->size * sizeof(int));
+        long long bytes = (long long)count * element_size();
+        if (reader_read(&file->reader, sequence, bytes) != bytes) {
+            printf("Error reading the file\n");
+            exit(EXIT_FAILURE);
+        }
+        to_keys(sequence, count);
+        add_to_fingerprint(&file->input_fingerprint, (int *)sequence, (long long)count * (element_size() / sizeof(int)));
+
+    } else {
+        char *records = file->records + (size_t)file->loaded * file->record_size;
+        unsigned long long *pairs = (unsigned long long *)file->sequence + file->loaded;
 
-    // Read the contents of the file
-    int num;
-    int i = 0;
-    while(fread(&num, sizeof(int), 1, file->file) == 1) {
-        file->sequence[i] = num;
-        i++;
+        long long bytes = (long long)count * file->record_size;
+        if (reader_read(&file->reader, records, bytes) != bytes) {
+            printf("Error reading the file\n");
+            exit(EXIT_FAILURE);
+        }
+        add_to_fingerprint(&file->input_fingerprint, (int *)records, (long long)count * (file->record_size / sizeof(int)));
+
+        // (key, index) pairs: the key, with the sign bit flipped so that the unsigned order is
+        // the order of the keys, in the high half and the index of the record in the low half,
+        // so equal keys keep the order of the file (stable sort)
+        for (int i = 0; i < count; i++) {
+            int key;
+            memcpy(&key, records + (size_t)i * file->record_size, sizeof(int));
+            pairs[i] = ((unsigned long long)((unsigned int)key ^ 0x80000000u) << 32) | (unsigned int)(file->loaded + i);
+        }
     }
-   
-    // Close the file
-    fclose(file->file);
+    file->loaded += count;
+
+    return file->loaded;
+}
+
+/**
+ *  \brief Close the file.
+ */
+void close_file() {
+    close_reader(&file->reader);
+}
+
+/**
+ *  \brief Read the file.
+ *
+ *  Reads a binary file and stores its content in an array of integers.
+ *
+ */
+void read_file() {
+    open_file();
+
+    do {
+        read_block();
+    } while (file->loaded < file->size);
+
+    close_file();
+}
+
+/**
+ *  \brief Write the sorted sequence to a file.
+ *
+ *  Writes the header and the sorted elements (or records), in the format of the input.
+ *  The keys of floating-point numbers are transformed back, so it is done after validate.
+ *
+ *  \param filename contains the name of the file
+ */
+void write_file(char *filename) {
+    FILE *output = fopen(filename, "wb");
+
+    if (output == NULL) {
+        printf("Error opening the file %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    bool written;
+    if (file->typed_header) {
+        int magic = TYPED_HEADER_MAGIC;
+        int type = file->type;
+        long long size = file->size;
+
+        written = fwrite(&magic, sizeof(int), 1, output) == 1 && fwrite(&type, sizeof(int), 1, output) == 1 &&
+                  fwrite(&size, sizeof(long long), 1, output) == 1;
+    } else {
+        written = fwrite(&file->size, sizeof(int), 1, output) == 1;
+    }
+
+    if (file->record_size == 0) {
+        from_keys(file->result, file->size);
+        written = written && fwrite(file->result, element_size(), file->size, output) == (size_t)file->size;
+    } else {
+        written = written && fwrite(file->sorted_records, file->record_size, file->size, output) == (size_t)file->size;
+    }
+
+    if (fclose(output) != 0 || !written) {
+        printf("Error writing the file %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ *  \brief Get the elements of a subsequence.
+ *
+ *  \param subseq contains the subsequence
+ *
+ *  \return pointer to the first element of the subsequence in the buffer it lives in.
+ */
+static void *subsequence_data(struct SubSequence *subseq) {
+    char *buffer = (char *)(subseq->in_merge_buffer ? file->merge_buffer : file->sequence);
+    return buffer + subseq->offset * element_size();
 }
 
 /**
  *  \brief Divide the work between the workers.
  *
  *  Operation carried out by the distributor.
+ *
+ *  The sequence is divided into a power of two number of sort tasks, so every sort task
+ *  is a leaf at the same depth of the merge tree and the merges alternate between the
+ *  initial sequence and the merge buffer level by level. The tree is stored as a heap:
+ *  task i merges the tasks 2i + 1 and 2i + 2.
  * 
  *  \param n_workers contains the number of workers
  */
-void divide_work(int n) {
+void divide_work(int n_workers) {
 
-    file->all_subsequences = (struct SubSequence**)malloc(n * sizeof(struct SubSequence));
-    file->all_subsequences_length = n;
+    int n_sort_tasks = 1;
+    while (n_sort_tasks < n_workers * SORT_TASKS_PER_WORKER && file->size / (2 * n_sort_tasks) >= MIN_SORT_TASK_SIZE) {
+        n_sort_tasks *= 2;
+    }
+
+    file->n_tasks = 2 * n_sort_tasks - 1;
+
+    // with records, the gather task follows the merge tree
+    file->tasks = (struct Task *)malloc((file->n_tasks + 1) * sizeof(struct Task));
 
-    int part_size = file->size / n;
-    int remainder = file->size % n;
+    // the merges alternate between the initial sequence and this buffer, no other copy of the data is made
+    file->merge_buffer = malloc(file->size * element_size());
+
+    // sort tasks
+    int part_size = file->size / n_sort_tasks;
+    int remainder = file->size % n_sort_tasks;
     int start = 0;
-    for (int i = 0; i < n; i++) {
-        struct SubSequence *subseq = (struct SubSequence*)malloc(sizeof(struct SubSequence));
+    for (int i = 0; i < n_sort_tasks; i++) {
+        struct Task *task = &file->tasks[n_sort_tasks - 1 + i];
 
         int end = start + part_size + (i < remainder ? 1 : 0);
 
-        subseq->subsequence = (int*)malloc((end - start) * sizeof(int));
-        subseq->size = (end - start);
-        subseq->is_being_processed = false;
-        subseq->is_sorted = false;
+        task->type = "sort";
+        task->subsequence.offset = start;
+        task->subsequence.size = (end - start);
+        task->subsequence.in_merge_buffer = false;
+        task->left = NULL;
+        task->right = NULL;
+        task->parent = NULL;
+        task->dependencies = 0;
+        task->n_parts = 1;
+        task->parts_remaining = 1;
+
+        start = end;
+    }
+
+    // merge tree
+    for (int i = n_sort_tasks - 2; i >= 0; i--) {
+        struct Task *task = &file->tasks[i];
+
+        task->type = "merge";
+        task->left = &file->tasks[2 * i + 1];
+        task->right = &file->tasks[2 * i + 2];
+        task->parent = NULL;
+        task->left->parent = task;
+        task->right->parent = task;
+        task->dependencies = 2;
+
+        // the two subsequences are adjacent, so the merged one takes the same positions of the other buffer
+        task->subsequence.offset = task->left->subsequence.offset;
+        task->subsequence.size = task->left->subsequence.size + task->right->subsequence.size;
+        task->subsequence.in_merge_buffer = !task->left->subsequence.in_merge_buffer;
+
+        // split the merge in one part per worker, unless the parts would be too small
+        task->n_parts = task->subsequence.size / MIN_MERGE_PART_SIZE;
+        if (task->n_parts > n_workers) task->n_parts = n_workers;
+        if (task->n_parts < 1) task->n_parts = 1;
+        task->parts_remaining = task->n_parts;
+    }
+
+    file->result = subsequence_data(&file->tasks[0].subsequence);
+
+    if (file->record_size) {
+        struct Task *task = &file->tasks[file->n_tasks];
+        int block = GATHER_BLOCK_BYTES / file->record_size;
+        if (block < 1) block = 1;
+
+        file->sorted_records = (char *)malloc((size_t)file->size * file->record_size);
+
+        task->type = "gather";
+        task->subsequence = file->tasks[0].subsequence;
+        task->left = &file->tasks[0];
+        task->right = NULL;
+        task->parent = NULL;
+        task->left->parent = task;
+        task->dependencies = 1;
+        task->n_parts = (file->size + block - 1) / block;
+        if (task->n_parts < 1) task->n_parts = 1;
+        task->parts_remaining = task->n_parts;
+    }
+}
 
-        int k = 0;
-        for (int j = start; j < end; j++) {
-            subseq->subsequence[k] = file->sequence[j];
-            k++;
+/**
+ *  \brief Push the parts of a task to the bottom of a deque.
+ *
+ *  Operation carried out inside the monitor, the workers waiting for work are woken up.
+ *
+ *  \param deque contains the deque
+ *  \param task contains the task
+ */
+static void push_task(struct Deque *deque, struct Task *task) {
+    pthread_mutex_lock(&deque->lock);
+
+    if (deque->bottom - deque->top + task->n_parts > deque->capacity) {
+        // grow the deque, keeping the work in the same order
+        int capacity = 2 * (deque->capacity + task->n_parts);
+        struct Work *work = (struct Work *)malloc(capacity * sizeof(struct Work));
+        for (int i = deque->top; i < deque->bottom; i++) {
+            work[i - deque->top] = deque->work[i % deque->capacity];
         }
+        free(deque->work);
 
-        start = end;
-        file->all_subsequences[i] = subseq;
+        deque->bottom -= deque->top;
+        deque->top = 0;
+        deque->work = work;
+        deque->capacity = capacity;
+    }
+
+    // the last part is pushed first, so the owner starts with the first one
+    for (int part = task->n_parts - 1; part >= 0; part--) {
+        struct Work *work = &deque->work[deque->bottom % deque->capacity];
+        work->task = task;
+        work->part = part;
+        deque->bottom++;
+    }
+
+    pthread_mutex_unlock(&deque->lock);
+
+    pending_work += task->n_parts;
+    if (task->n_parts == 1) {
+        pthread_cond_signal(&work_available_cond);
+    } else {
+        pthread_cond_broadcast(&work_available_cond);
     }
 }
 
+/**
+ *  \brief Take work from a deque.
+ *
+ *  \param deque contains the deque
+ *  \param work will store the work taken
+ *  \param steal true to take the oldest work (top), false to take the newest one (bottom)
+ *
+ *  \return true if there was work in the deque, false otherwise.
+ */
+static bool take_work(struct Deque *deque, struct Work *work, bool steal) {
+    bool taken = false;
+
+    pthread_mutex_lock(&deque->lock);
+
+    if (deque->top < deque->bottom) {
+        if (steal) {
+            *work = deque->work[deque->top % deque->capacity];
+            deque->top++;
+        } else {
+            deque->bottom--;
+            *work = deque->work[deque->bottom % deque->capacity];
+        }
+        taken = true;
+    }
+
+    pthread_mutex_unlock(&deque->lock);
+
+    return taken;
+}
 
 /**
- *  \brief Listening for workers' activity and handling their requests.
+ *  \brief Distribute the sort tasks and wait for the work to be done.
  *
- *  Operation carried out by the distributor.
+ *  Operation carried out by the distributor. The workers stay available for another
+ *  sort until finish_work is called.
  * 
  *  \param n_workers contains the number of workers
  */
-void listen(int n_workers) {
-    // enter monitor 
-    if ((distributor_status = pthread_mutex_lock(&accessCR)) != 0) {
-        errno = distributor_status;           // save error in errno
-        distributor_status = EXIT_FAILURE;
-        perror("[error] on entering monitor(CF)");
-        pthread_exit(NULL);
-    }
+void distribute_work(int n_workers) {
+    int n_sort_tasks = (file->n_tasks + 1) / 2;
+    int next_sort_task = 0;
 
-    while (true) {
-        // wait for a work request
-        while (!work_requested) {
-            // in case there are workers in the waiting queue
-            if (!empty_queue) break;
-            
-            if ((distributor_status = pthread_cond_wait(&work_request_cond, &accessCR)) != 0) { 
-                errno = distributor_status;                          // save error in errno 
-                perror ("[error] on waiting for worker's request");
-                distributor_status = EXIT_FAILURE;
-                pthread_exit (&distributor_status);
-            }
-        }     
-
-        // distribute work
-        int worker_id = waiting_work_queue[0];      // get the fist worker waiting for work
-
-        // before distributing the sorting work, check if there is a way to assign merge work
-        int sorted_subsequences = 0;
-        int *subsequences_to_merge = (int*)malloc(2 * sizeof(int));
-        for (int i = 0; i < file->all_subsequences_length; i++) {
-            if (file->all_subsequences[i]->is_sorted && sorted_subsequences < 2) {
-                subsequences_to_merge[sorted_subsequences] = i;
-                sorted_subsequences++;  
-            } 
-        }
+    // no worker is busy: the previous sort, if any, is done
+    sort_done = false;
 
+    // the sort tasks are dealt to the workers in round robin as soon as their part of the sequence is read,
+    // so that reading the file overlaps with sorting; the merges are pushed by the workers themselves
+    while (next_sort_task < n_sort_tasks) {
+        int loaded = read_block();
 
-        if (sorted_subsequences == 2) {
-            // merge
-            printf("[distributor] distributes merge task to worker %d\n", worker_id);
-            (tasks + worker_id)->type = "merge";
-            (tasks + worker_id)->index_sequence1 = subsequences_to_merge[0];   // addresses the subsequence id in all_subsequences
-            (tasks + worker_id)->index_sequence2 = subsequences_to_merge[1];   // addresses the subsequence id in all_subsequences
-            (tasks + worker_id)->is_busy = true;
+        // enter monitor 
+        if ((distributor_status = pthread_mutex_lock(&accessCR)) != 0) {
+            errno = distributor_status;           // save error in errno
+            distributor_status = EXIT_FAILURE;
+            perror("[error] on entering monitor(CF)");
+            pthread_exit(NULL);
+        }
 
-        } else { 
-            // sort task
-            for (int i = 0; i < n_workers; i++) {           
-                if (!file->all_subsequences[i]->is_being_processed) {
-                    // assign to worker the subsequence file->all_subsequences[i]->subsequence
-                    printf("[distributor] distributes sort task of the subsequence %d to worker %d\n", worker_id, worker_id);
+        while (next_sort_task < n_sort_tasks) {
+            struct Task *task = &file->tasks[n_sort_tasks - 1 + next_sort_task];
+            if (task->subsequence.offset + task->subsequence.size > (unsigned int)loaded) break;
 
-                    file->all_subsequences[i]->is_being_processed = true;
+            push_task(&deques[next_sort_task % n_workers], task);
+            next_sort_task++;
+        }
 
-                    (tasks + worker_id)->type = "sort";
-                    (tasks + worker_id)->index_sequence1 = i;   // addresses the subsequence id in all_subsequences
-                    (tasks + worker_id)->is_busy = true;
-                    break;
-                }
-            }
+        // exit monitor
+        if ((distributor_status = pthread_mutex_unlock(&accessCR)) != 0) {
+            errno = distributor_status;           // save error in errno
+            distributor_status = EXIT_FAILURE;
+            perror("[error] on exting monitor(CF)");
+            pthread_exit(NULL);
         }
+    }
+    printf("[distributor] distributed %d sort tasks to %d workers\n", n_sort_tasks, n_workers);
 
-        // reset the work flag
-        work_requested = false;
+    // enter monitor 
+    if ((distributor_status = pthread_mutex_lock(&accessCR)) != 0) {
+        errno = distributor_status;           // save error in errno
+        distributor_status = EXIT_FAILURE;
+        perror("[error] on entering monitor(CF)");
+        pthread_exit(NULL);
+    }
 
-        // Wait for the work_done notification
+    // wait for the work_done notification
+    while (!sort_done) {
         if ((distributor_status = pthread_cond_wait(&work_done_cond, &accessCR)) != 0) { 
             errno = distributor_status;                          // save error in errno 
             perror ("[error] on waiting for worker's notification");
             distributor_status = EXIT_FAILURE;
             pthread_exit (&distributor_status);
         }
-
-        printf("[distributor] notification that the work is done received\n");
-
-        // remove first element of waiting_work_queue and decrease the pointer to last element, index_waiting_queue
-        int i;
-        for (i = 0; i < index_waiting_queue; i++) {
-            waiting_work_queue[i] = waiting_work_queue[i + 1];
-        }
-        waiting_work_queue[i] = -1;
-        index_waiting_queue--;
-        if (index_waiting_queue == 0) empty_queue = true;
-        
-        (tasks + worker_id)->is_busy = false;
-
-
-        if (file->all_subsequences_length == 1) {
-            all_work_done = true;
-            break;
-        }
     }
 
+    printf("[distributor] notification that the work is done received\n");
+
     // exit monitor
     if ((distributor_status = pthread_mutex_unlock(&accessCR)) != 0) {
         errno = distributor_status;           // save error in errno
@@ -284,240 +736,392 @@ void listen(int n_workers) {
 }
 
 /**
- *  \brief Request for work.
+ *  \brief Let the workers know that there are no more sorts.
  *
- *  Operation carried out by the workers.
+ *  Operation carried out by the distributor, the workers waiting for work terminate.
  */
-void request_work(int worker_id) {
-    // signal the distributor thread that work has been requested
+void finish_work() {
     // enter monitor 
-    if ((workers_status[worker_id] = pthread_mutex_lock(&accessCR)) != 0) {
-        errno = workers_status[worker_id];           // save error in errno
-        workers_status[worker_id] = EXIT_FAILURE;
+    if ((distributor_status = pthread_mutex_lock(&accessCR)) != 0) {
+        errno = distributor_status;           // save error in errno
+        distributor_status = EXIT_FAILURE;
         perror("[error] on entering monitor(CF)");
         pthread_exit(NULL);
     }
 
-    printf("[worker %d] requesting work\n", worker_id);
-    work_requested = true;
-    empty_queue = false;
+    all_work_done = true;
 
-    waiting_work_queue[index_waiting_queue] = worker_id;
-    index_waiting_queue++;
-    
-    if ((workers_status[worker_id] = pthread_cond_signal (&work_request_cond)) != 0){ 
-        errno = workers_status[worker_id];           // save error in errno
-        perror ("[error] on requesting work to the distributor");
-        workers_status[worker_id] = EXIT_FAILURE;
-        pthread_exit (&workers_status[worker_id]);
+    if ((distributor_status = pthread_cond_broadcast(&work_available_cond)) != 0) {
+        errno = distributor_status;           // save error in errno
+        perror("[error] on notifying that work is done");
+        distributor_status = EXIT_FAILURE;
+        pthread_exit(&distributor_status);
     }
 
     // exit monitor
-    if ((workers_status[worker_id] = pthread_mutex_unlock(&accessCR)) != 0) {
-        errno = workers_status[worker_id];           // save error in errno
-        workers_status[worker_id] = EXIT_FAILURE;
+    if ((distributor_status = pthread_mutex_unlock(&accessCR)) != 0) {
+        errno = distributor_status;           // save error in errno
+        distributor_status = EXIT_FAILURE;
         perror("[error] on exting monitor(CF)");
         pthread_exit(NULL);
     }
 }
 
 /**
- *  \brief Sort a sequence.
+ *  \brief Request for work.
  *
- *  Operation carried out by the workers.
+ *  Operation carried out by the workers. The worker takes work from its own deque,
+ *  steals it from another worker or blocks until there is work available.
  *
- *  \param id contains the id of the sequence to be sorted
+ *  \param worker_id contains the id of the worker
+ *  \param work will store the work to be done
+ *
+ *  \return true if work was assigned, false if all work is done.
  */
-void sort_sequence(int id) {
-    // sort sequence
+bool request_work(int worker_id, struct Work *work) {
+    while (true) {
+        // own work first, then steal from the other workers
+        bool taken = take_work(&deques[worker_id], work, false);
+        for (int i = 1; i < n_deques && !taken; i++) {
+            taken = take_work(&deques[(worker_id + i) % n_deques], work, true);
+        }
+
+        // enter monitor 
+        if ((workers_status[worker_id] = pthread_mutex_lock(&accessCR)) != 0) {
+            errno = workers_status[worker_id];           // save error in errno
+            workers_status[worker_id] = EXIT_FAILURE;
+            perror("[error] on entering monitor(CF)");
+            pthread_exit(NULL);
+        }
+
+        if (taken) {
+            pending_work--;
+        } else {
+            // wait until there is work available
+            while (pending_work == 0 && !all_work_done) {
+                if ((workers_status[worker_id] = pthread_cond_wait(&work_available_cond, &accessCR)) != 0) {
+                    errno = workers_status[worker_id];           // save error in errno
+                    perror ("[error] on waiting for work");
+                    workers_status[worker_id] = EXIT_FAILURE;
+                    pthread_exit (&workers_status[worker_id]);
+                }
+            }
+        }
 
-    int subseq_index = (tasks + id)->index_sequence1;
-    struct SubSequence *sub_seq = file->all_subsequences[subseq_index];
+        bool done = all_work_done;
 
-    bitonicSort(sub_seq->subsequence, sub_seq->size);
-    sub_seq->is_sorted = true;
-    file->all_subsequences[subseq_index] = sub_seq;
+        // exit monitor
+        if ((workers_status[worker_id] = pthread_mutex_unlock(&accessCR)) != 0) {
+            errno = workers_status[worker_id];           // save error in errno
+            workers_status[worker_id] = EXIT_FAILURE;
+            perror("[error] on exting monitor(CF)");
+            pthread_exit(NULL);
+        }
 
-    printf("[worker %d] sorted the sequence!\n", id);
+        if (taken) return true;
+        if (done) return false;
+    }
 }
 
 /**
- *  \brief Notify the distributor that work has been completed.
+ *  \brief Sort a sequence.
  *
- *  Operation carried out by the workers.
+ *  Operation carried out by the workers. The natural runs are merged with the room of
+ *  the subsequence in the other buffer, which is not used until its parent is merged.
  *
- *  \param id contains the worker id that has completed its task
+ *  \param worker_id contains the id of the worker
+ *  \param task contains the sort task
  */
-void notify(int id) {
-    // Signal the distributor thread that work has been finished
+void sort_sequence(int worker_id, struct Task *task) {
+    if (natural_runs) {
+        struct SubSequence other = task->subsequence;
+        other.in_merge_buffer = !other.in_merge_buffer;
+
+        int n_runs = file->kernels->sort_runs(subsequence_data(&task->subsequence), task->subsequence.size, subsequence_data(&other));
+        printf("[worker %d] sorted a sequence of %d integers with %d natural runs!\n", worker_id, task->subsequence.size, n_runs);
+        return;
+    }
+
+    // sort sequence
+    file->kernels->sort(subsequence_data(&task->subsequence), task->subsequence.size);
+
+    printf("[worker %d] sorted a sequence of %d integers!\n", worker_id, task->subsequence.size);
+}
+
+/**
+ *  \brief Notify that work has been completed.
+ *
+ *  Operation carried out by the workers. When the last part of a task is done, the
+ *  task that depends on it is pushed to the worker's deque once all its inputs are ready.
+ *
+ *  \param worker_id contains the id of the worker that has completed the work
+ *  \param work contains the completed work
+ */
+void notify(int worker_id, struct Work *work) {
     // Enter monitor
-    if ((workers_status[id] = pthread_mutex_lock(&accessCR)) != 0) {
-        errno = workers_status[id];           // save error in errno
-        workers_status[id] = EXIT_FAILURE;
+    if ((workers_status[worker_id] = pthread_mutex_lock(&accessCR)) != 0) {
+        errno = workers_status[worker_id];           // save error in errno
+        workers_status[worker_id] = EXIT_FAILURE;
         perror("[error] on entering monitor(CF)");
         pthread_exit(NULL);
     }
 
-    printf("[worker %d] notifying that work is done\n", id);
+    struct Task *task = work->task;
+
+    if (--task->parts_remaining == 0) {
+        if (task->parent == NULL) {
+            // the root of the merge tree is done
+            sort_done = true;
 
-    if ((workers_status[id] = pthread_cond_signal(&work_done_cond)) != 0) { 
-        errno = workers_status[id];           // save error in errno
-        perror("[error] on notifying distributor that work is done");
-        workers_status[id] = EXIT_FAILURE;
-        pthread_exit(&workers_status[id]);
+            if ((workers_status[worker_id] = pthread_cond_signal(&work_done_cond)) != 0) {
+                errno = workers_status[worker_id];           // save error in errno
+                perror("[error] on notifying that work is done");
+                workers_status[worker_id] = EXIT_FAILURE;
+                pthread_exit(&workers_status[worker_id]);
+            }
+
+        } else if (--task->parent->dependencies == 0) {
+            // both inputs of the merge are ready
+            push_task(&deques[worker_id], task->parent);
+        }
     }
 
     // Exit monitor
-    if ((workers_status[id] = pthread_mutex_unlock(&accessCR)) != 0) {
-        errno = workers_status[id];           // save error in errno
-        workers_status[id] = EXIT_FAILURE;
+    if ((workers_status[worker_id] = pthread_mutex_unlock(&accessCR)) != 0) {
+        errno = workers_status[worker_id];           // save error in errno
+        workers_status[worker_id] = EXIT_FAILURE;
         perror("[error] on exiting monitor(CF)");
         pthread_exit(NULL);
     }
-    
 }
 
 
-void compareAndPossibleSwap(int *val, int i, int j, int dir) {
-    if ((val[i] > val[j]) == dir) {
-        int temp = val[i];
-        val[i] = val[j];
-        val[j] = temp;
+/**
+ *  \brief Merge one part of two sequences.
+ *
+ *  Operation carried out by the workers.
+ *
+ *  \param worker_id contains the id of the worker
+ *  \param task contains the merge task
+ *  \param part contains the part of the merge assigned to the worker
+ */
+void merge_sequences(int worker_id, struct Task *task, int part) {
+    int size = task->subsequence.size;
+
+    // positions of the merged sequence covered by this part
+    int k     = (int)((long long)size * part / task->n_parts);
+    int k_end = (int)((long long)size * (part + 1) / task->n_parts);
+
+    file->kernels->merge(subsequence_data(&task->left->subsequence), task->left->subsequence.size,
+                         subsequence_data(&task->right->subsequence), task->right->subsequence.size,
+                         subsequence_data(&task->subsequence), k, k_end);
+
+    if (task->n_parts > 1) {
+        printf("[worker %d] merge part %d of %d done\n", worker_id, part + 1, task->n_parts);
+    } else {
+        printf("[worker %d] merge done\n", worker_id);
     }
 }
 
-void bitonicMerge(int *val, int low, int cnt, int dir) {
-    if (cnt > 1) {
-        int k = cnt / 2;
-        for (int i = low; i < low + k; i++) {
-            compareAndPossibleSwap(val, i, i + k, dir);
-        }
-        bitonicMerge(val, low, k, dir);
-        bitonicMerge(val, low + k, k, dir);
+/**
+ *  \brief Gather one block of the sorted records.
+ *
+ *  Operation carried out by the workers, once the (key, index) pairs are sorted.
+ *
+ *  The block of sorted records is small enough to stay in the cache while it is filled, and
+ *  its records are fetched in the order they are in the file (the pairs of the block are sorted
+ *  by index first), so the reads of the records go forward through memory.
+ *
+ *  \param worker_id contains the id of the worker
+ *  \param task contains the gather task
+ *  \param part contains the block of the sorted records assigned to the worker
+ */
+void gather_records(int worker_id, struct Task *task, int part) {
+    unsigned long long *pairs = (unsigned long long *)file->result;
+    int record_size = file->record_size;
+
+    int start = (int)((long long)file->size * part / task->n_parts);
+    int end   = (int)((long long)file->size * (part + 1) / task->n_parts);
+
+    // (index in the file, position in the block) pairs
+    unsigned long long *sources = (unsigned long long *)malloc((end - start) * sizeof(unsigned long long));
+    for (int i = start; i < end; i++) {
+        sources[i - start] = ((pairs[i] & 0xffffffffULL) << 32) | (unsigned int)(i - start);
     }
-}
+    bitonicSort_u64(sources, end - start);
+
+    char *block = file->sorted_records + (size_t)start * record_size;
+    for (int i = 0; i < end - start; i++) {
+        size_t index = sources[i] >> 32;
+        size_t position = sources[i] & 0xffffffffULL;
 
-void bitonicSortRecursive(int *val, int low, int cnt, int dir) {
-    if (cnt > 1) {
-        int k = cnt / 2;
-        bitonicSortRecursive(val, low, k, !dir);
-        bitonicSortRecursive(val, low + k, k, dir);
-        bitonicMerge(val, low, cnt, dir);
+        memcpy(block + position * record_size, file->records + index * record_size, record_size);
     }
+
+    free(sources);
+
+    printf("[worker %d] gathered block %d of %d of the sorted records\n", worker_id, part + 1, task->n_parts);
 }
 
+
 /**
- *  \brief Applies the Bitonic Sort algorithm to a subsequence of integers.
+ *  \brief Hash of an integer (splitmix64 finalizer).
  *
- *  Operation carried out by the workers.
+ *  \param value contains the integer
  *
- *  \param val contains the subsequence of integers to be sorted
- *  \param N contains the size of the subsequence
+ *  \return hash of the integer.
  */
-void bitonicSort(int *val, int N) {
-    bitonicSortRecursive(val, 0, N, 1);
+static inline unsigned long long hash(int value) {
+    unsigned long long x = (unsigned int)value + 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
 }
 
 /**
- *  \brief Merge two sequences.
- *
- *  Operation carried out by the workers. 
+ *  \brief Add integers to a fingerprint.
  *
- *  \param worker_id contains the worker id that was assigned to merge the subsequences
+ *  \param fingerprint contains the fingerprint
+ *  \param values contains the integers
+ *  \param n contains the number of integers
  */
-void merge_sequences(int worker_id) {
+void add_to_fingerprint(struct Fingerprint *fingerprint, int *values, long long n) {
+    unsigned long long sum = 0, parity = 0, hash_sum = 0;
 
-    int index_subsequence1 = (tasks + worker_id)->index_sequence1;
-    int index_subsequence2 = (tasks + worker_id)->index_sequence2;
+    for (long long i = 0; i < n; i++) {
+        sum += (unsigned int)values[i];
+        parity ^= (unsigned int)values[i];
+        hash_sum += hash(values[i]);
+    }
 
-    int *left = file->all_subsequences[index_subsequence1]->subsequence;
-    int left_size = file->all_subsequences[index_subsequence1]->size;
+    fingerprint->sum += sum;
+    fingerprint->parity ^= parity;
+    fingerprint->hash_sum += hash_sum;
+}
 
-    int *right = file->all_subsequences[index_subsequence2]->subsequence;
-    int right_size = file->all_subsequences[index_subsequence2]->size;
+/**
+ *  \brief Compare two fingerprints.
+ *
+ *  \return true if the fingerprints are equal, false otherwise.
+ */
+bool same_fingerprint(struct Fingerprint *a, struct Fingerprint *b) {
+    return a->sum == b->sum && a->parity == b->parity && a->hash_sum == b->hash_sum;
+}
 
-    int *merged_subsequence = (int*)malloc((left_size + right_size) * sizeof(int));
+/**
+ *  \brief Key of a sorted record.
+ *
+ *  \param i contains the position of the record
+ *
+ *  \return key of the record.
+ */
+static int record_key(int i) {
+    int key;
+    memcpy(&key, file->sorted_records + (size_t)i * file->record_size, sizeof(int));
+    return key;
+}
 
-    int i = 0, j = 0, k = 0;
+/**
+ *  \brief Validate a block of the sorted sequence.
+ *
+ *  Operation carried out by the validation threads.
+ *
+ *  \param arg contains the block (struct ValidationBlock)
+ */
+static void *validate_block(void *arg) {
+    struct ValidationBlock *block = (struct ValidationBlock *)arg;
 
-    while (i < left_size && j < right_size) {
-        if (left[i] <= right[j]) {
-            merged_subsequence[k++] = left[i++];
-        } else {
-            merged_subsequence[k++] = right[j++];
-        }
-    }
+    // the last pair of the block crosses into the next one
+    int last = (block->end < file->size) ? block->end : file->size - 1;
 
-    while (i < left_size) {
-        merged_subsequence[k++] = left[i++];
-    }
+    memset(&block->fingerprint, 0, sizeof(struct Fingerprint));
 
-    while (j < right_size) {
-        merged_subsequence[k++] = right[j++];
-    }
+    if (file->record_size == 0) {
+        long long ints_per_element = element_size() / sizeof(int);
 
-    printf("[worker %d] merge done\n", worker_id);
+        block->first_error = file->kernels->first_unsorted(file->result, block->start, last);
+        add_to_fingerprint(&block->fingerprint, (int *)file->result + (size_t)block->start * ints_per_element,
+                           (block->end - block->start) * ints_per_element);
 
-    int new_size = file->all_subsequences_length - 1;
-    struct SubSequence **new_all_subseqs = (struct SubSequence**)malloc(new_size * sizeof(struct SubSequence *));
-    
-    int idx = 0;
-    bool put_merged_subsequence = false;
-    for (int i = 0; i < file->all_subsequences_length; i++) {
-        if ((i == index_subsequence1 || i == index_subsequence2)) {
-            if (!put_merged_subsequence) {            
-                struct SubSequence *subseq = (struct SubSequence*)malloc(sizeof(struct SubSequence));
-                subseq->subsequence = merged_subsequence;
-                subseq->size = left_size + right_size;
-                subseq->is_sorted = true;
-                subseq->is_being_processed = true;
-                new_all_subseqs[idx++] = subseq;
-                put_merged_subsequence = true;
-            }
-        } else {  // copy the subsequence
-            new_all_subseqs[idx++] = file->all_subsequences[i];
-        }
-    }
+    } else {
+        // the pairs are in order of key and index (stable), and so are the keys of the gathered records
+        block->first_error = first_unsorted_u64(file->result, block->start, last);
 
-    for (int i = 0; i < file->all_subsequences_length; i++) {
-        if (i == index_subsequence1 || i == index_subsequence2) {
-            free(file->all_subsequences[i]);
+        for (int i = block->start; i < last && block->first_error < 0; i++) {
+            if (record_key(i) > record_key(i + 1)) block->first_error = i;
         }
+
+        long long ints_per_record = file->record_size / sizeof(int);
+        add_to_fingerprint(&block->fingerprint, (int *)(file->sorted_records + (size_t)block->start * file->record_size),
+                           (block->end - block->start) * ints_per_record);
     }
-    free(file->all_subsequences);
-    
-    file->all_subsequences = new_all_subseqs;
-    file->all_subsequences_length = new_size;
 
+    return NULL;
 }
 
-
 /**
  *  \brief Validate the sort method
  *
- *  Check in the end if the sequence of values is properly sorted
+ *  Check in the end if the sequence of values is properly sorted and has the same
+ *  integers as the file. The sequence is split in one block per thread.
  *
+ *  \param n_threads contains the number of threads
  */
-void validate() {
+void validate(int n_threads) {
 
     printf ("\n");
 
-    int *val = file->all_subsequences[0]->subsequence;
-    int N    = file->all_subsequences[0]->size;
+    int N = file->size;
+
+    if (n_threads > N / MIN_SORT_TASK_SIZE) n_threads = N / MIN_SORT_TASK_SIZE;
+    if (n_threads < 1) n_threads = 1;
 
-    int i;
-    for (i = 0; i < N; i++) {
+    struct ValidationBlock *blocks = (struct ValidationBlock *)malloc(n_threads * sizeof(struct ValidationBlock));
+    pthread_t *threads = (pthread_t *)malloc(n_threads * sizeof(pthread_t));
 
-        if (i == (N - 1))  {
-            printf ("Everything is OK!\n");
-            break;
+    for (int t = 0; t < n_threads; t++) {
+        blocks[t].start = (int)((long long)N * t / n_threads);
+        blocks[t].end   = (int)((long long)N * (t + 1) / n_threads);
+
+        if (pthread_create(&threads[t], NULL, validate_block, &blocks[t]) != 0) {
+            perror("[error] on creating thread validator");
+            exit(EXIT_FAILURE);
         }
+    }
+
+    int first_error = -1;
+    struct Fingerprint output_fingerprint = {0, 0, 0};
 
-        if (val[i] > val[i+1]) { 
-            printf ("Error in position %d between element %d and %d\n", i, val[i], val[i+1]);
-            break;
+    for (int t = 0; t < n_threads; t++) {
+        if (pthread_join(threads[t], NULL) != 0) {
+            perror("[error] on waiting for validator thread");
+            exit(EXIT_FAILURE);
         }
+
+        // the blocks are in order, the first error found is the first of the sequence
+        if (first_error < 0) first_error = blocks[t].first_error;
+
+        output_fingerprint.sum += blocks[t].fingerprint.sum;
+        output_fingerprint.parity ^= blocks[t].fingerprint.parity;
+        output_fingerprint.hash_sum += blocks[t].fingerprint.hash_sum;
     }
 
+    if (first_error >= 0 && file->record_size == 0) {
+        printf ("Error in position %d between element ", first_error);
+        print_element(file->result, first_error);
+        printf (" and ");
+        print_element(file->result, first_error + 1);
+        printf ("\n");
+    } else if (first_error >= 0) {
+        printf ("Error in position %d between the records with keys %d and %d\n", first_error, record_key(first_error), record_key(first_error + 1));
+    } else if (!same_fingerprint(&output_fingerprint, &file->input_fingerprint)) {
+        printf ("Error: the sorted sequence does not have the same integers as the file\n");
+    } else {
+        printf ("Everything is OK!\n");
+    }
+
+    free(blocks);
+    free(threads);
+
     printf ("\n");
-}
\ No newline at end of file
+}
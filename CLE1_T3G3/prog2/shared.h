@@ -1,60 +1,215 @@
-
 #ifndef MONITOR_H
 #define MONITOR_H
 
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <pthread.h>
+
+#include "reader.h"
 
 
 /**
- *  \brief Structure with the task assigned to a worker.
+ *  \brief Structure that describes a subsequence of integers.
  *
- *   It stores the worker_id, type of task (sort or merge), index of the sequences to be processed and 
- *   a boolean flag to indicate if the worker is busy or not.
+ *   The subsequence is a view (offset and size) into one of the two buffers of the
+ *   file: the initial sequence or the merge buffer, which merges alternate between.
+ */
+struct SubSequence {
+  unsigned int offset;
+  unsigned int size;
+  bool in_merge_buffer;
+};
+
+
+/**
+ *  \brief Structure with a task of the sort, a node of the merge tree.
+ *
+ *   A sort task sorts one subsequence of the input in place. A merge task merges the
+ *   subsequences produced by its two children (left and right) and can only run once
+ *   both are done (dependencies). It is split by merge path into n_parts independent
+ *   pieces, so that all workers can share it. With records, a gather task depends on
+ *   the root of the merge tree and moves the records to their sorted position, one
+ *   block per part.
  */
 struct Task {
-    int worker_id;
-    char *type;
-    int index_sequence1;
-    int index_sequence2;
-    bool is_busy;
+  char *type;
+  struct SubSequence subsequence;
+  struct Task *left;
+  struct Task *right;
+  struct Task *parent;
+  int dependencies;
+  int n_parts;
+  int parts_remaining;
+};
+
+
+/**
+ *  \brief Structure with a piece of work: one part of a task.
+ */
+struct Work {
+  struct Task *task;
+  int part;
 };
 
 
 /**
- *  \brief Structure that contains a subsequence of integers.
+ *  \brief Double-ended queue of work owned by a worker.
  *
- *   It also stores the size of the subsequence and two booleans:
- *   one to check if it was already sorted and the other to check
- *   if it is being processed.
+ *   The owner pushes and pops work at the bottom, the other workers steal it
+ *   from the top.
  */
-struct SubSequence {
-  unsigned int *subsequence;
-  unsigned int size;
-  bool is_sorted;
-  bool is_being_processed;
+struct Deque {
+  struct Work *work;
+  int capacity;
+  int top;
+  int bottom;
+  pthread_mutex_t lock;
+};
+
+
+/**
+ *  \brief Types of the elements of a file.
+ *
+ *   A file whose header starts with TYPED_HEADER_MAGIC has the code of the type
+ *   of its elements (32-bit) and the number of elements (64-bit) after it,
+ *   any other file has 32-bit integers and their number in the header.
+ */
+enum ElementType { INT32, UINT32, INT64, UINT64, FLOAT32, FLOAT64 };
+
+/** \brief first 32 bits of a header with the type of the elements ("DSQ" and 0xff, a negative number of integers) */
+#define TYPED_HEADER_MAGIC ((int)0xff515344)
+
+
+/**
+ *  \brief Structure with the header of a file.
+ */
+struct Header {
+  long long size;
+  enum ElementType type;
+  bool typed;
+};
+
+
+/**
+ *  \brief Structure with the kernels of a type of element.
+ *
+ *   The floating-point numbers are sorted as unsigned integers of the same size,
+ *   after a transform which keeps their total order, so they use those kernels.
+ */
+struct Kernels {
+  size_t element_size;
+  void (*sort)(void *val, int N);
+  void (*merge)(void *left, int left_size, void *right, int right_size, void *merged, int k, int k_end);
+  int (*first_unsorted)(void *val, int start, int last);
+  int (*sort_runs)(void *val, int N, void *buffer);
+};
+
+
+/**
+ *  \brief Order-independent fingerprint of a multiset of integers.
+ *
+ *   Sum, bitwise parity (xor) and sum of a hash of the integers, all modulo 2^64: a
+ *   sorted sequence must have the same fingerprint as the input, so integers lost or
+ *   duplicated by the sort are detected.
+ */
+struct Fingerprint {
+  unsigned long long sum;
+  unsigned long long parity;
+  unsigned long long hash_sum;
+};
+
+
+/**
+ *  \brief Structure with a block of the sorted sequence to validate.
+ *
+ *   A thread checks the order of the integers from start to end, including the pair
+ *   that crosses into the next block, and computes their fingerprint. The position
+ *   of the first pair out of order is stored in first_error (-1 if there is none).
+ */
+struct ValidationBlock {
+  int start;
+  int end;
+  int first_error;
+  struct Fingerprint fingerprint;
 };
 
 
 /**
  *  \brief Structure with the filename and file pointer to process.
  *
- *   It also stores the number of integers in the file (size), the
- *   initial unsorted sequence of integers (*sequence) and an array of 
- *   pointers to all the subsequences (**all_subsequences).
- * 
+ *   It also stores the number of integers in the file (size) and how
+ *   many were already read (loaded), the
+ *   initial unsorted sequence of integers (*sequence), the buffer of
+ *   the same size the merges write to (*merge_buffer), the sorted
+ *   sequence (*result), which is in one of those two buffers, the
+ *   array with all the tasks (*tasks), the first one being the root of
+ *   the merge tree, and the fingerprint of the integers read.
+ *
+ *   The elements are of the type given by the header of the file (type and
+ *   typed_header), integers if it does not have one, and are sorted with the
+ *   kernels of that type (*kernels).
+ *
+ *   If the file has records (record_size is not 0), size is the number of
+ *   records, each one an integer key followed by a payload. The records are
+ *   read to *records, the sequence is made of (key, index) pairs packed in
+ *   64-bit integers and the records are gathered in the sorted order to
+ *   *sorted_records once the pairs are sorted.
+ *
  */
 struct File {
   char *filename;
   FILE *file;
+  struct Reader reader;
   int size;
-  unsigned int *sequence;
-  struct SubSequence **all_subsequences;
-  int all_subsequences_length;
+  int loaded;
+  enum ElementType type;
+  bool typed_header;
+  struct Kernels *kernels;
+  int record_size;
+  void *sequence;
+  void *merge_buffer;
+  void *result;
+  char *records;
+  char *sorted_records;
+  struct Task *tasks;
+  int n_tasks;
+  struct Fingerprint input_fingerprint;
 };
 
 
+/**
+ *  \brief Sort, merge and validation kernels of a type of element (see sortKernels.h).
+ */
+#define DECLARE_KERNELS(ELEMENT, NAME) \
+  extern void bitonicSort_##NAME(ELEMENT *val, int N); \
+  extern int co_rank_##NAME(int k, ELEMENT *left, int left_size, ELEMENT *right, int right_size); \
+  extern void merge_##NAME(ELEMENT *left, int left_size, ELEMENT *right, int right_size, ELEMENT *merged, int k, int k_end); \
+  extern int first_unsorted_##NAME(ELEMENT *val, int start, int last); \
+  extern int powerSort_##NAME(ELEMENT *val, int N, ELEMENT *buffer);
+
+/** \brief kernels of the 32-bit integers */
+DECLARE_KERNELS(int, int)
+
+/** \brief kernels of the 32-bit unsigned integers and of the transformed floats */
+DECLARE_KERNELS(unsigned int, u32)
+
+/** \brief kernels of the 64-bit integers */
+DECLARE_KERNELS(long long, i64)
+
+/** \brief kernels of the 64-bit unsigned integers, of the transformed doubles and of the (key, index) pairs of the records */
+DECLARE_KERNELS(unsigned long long, u64)
+
+
+/**
+ *  \brief Kernels of a type of element.
+ *
+ *  \param type contains the type of the elements
+ *
+ *  \return kernels that sort the elements (or their keys, for floating-point numbers).
+ */
+extern struct Kernels *kernels_of(enum ElementType type);
+
 /**
  *  \brief Initialization of the data transfer region.
  *
@@ -62,8 +217,64 @@ struct File {
  *  as argument and initializes it with their names.
  *
  *  \param filename contains the names of the files to be stored
+ *  \param n_workers contains the number of workers
+ *  \param record_size contains the number of bytes of a record, 0 if the file has integers
+ */
+extern void initialize(char *filename, int n_workers, int record_size);
+
+/**
+ *  \brief Read the header of a binary file.
+ *
+ *  Reads the type and the number of elements (or records) of the file and checks them
+ *  against the size of the file.
+ *
+ *  \param file_pointer contains the file, positioned at its beginning
+ *  \param record_size contains the number of bytes of a record, 0 if the file has no records
+ *
+ *  \return header of the file.
+ */
+extern struct Header read_header(FILE *file_pointer, int record_size);
+
+/**
+ *  \brief Open the file.
+ *
+ *  Reads the header of a binary file, checks it against the size of the file and
+ *  allocates the array of integers. The contents are read by read_block.
+ *
+ */
+extern void open_file();
+
+/**
+ *  \brief Start reading the elements of the file ahead.
+ *
+ *  The elements, from the end of the header, are read by a reader (see reader.h)
+ *  instead of the file pointer, which is closed.
+ */
+extern void read_ahead();
+
+/**
+ *  \brief Read a block of the file.
+ *
+ *  Reads the next block of integers straight into the array of integers, until size
+ *  integers are loaded.
+ *
+ *  \return number of integers read so far.
+ */
+extern int read_block();
+
+/**
+ *  \brief Close the file.
  */
-extern void initialize(char *filename, int n_workers);
+extern void close_file();
+
+/**
+ *  \brief Write the sorted sequence to a file.
+ *
+ *  Writes the header and the sorted integers (or records), in the format of the input.
+ *
+ *  \param filename contains the name of the file
+ */
+extern void write_file(char *filename);
 
 /**
  *  \brief Read the file.
@@ -73,74 +284,113 @@ extern void initialize(char *filename, int n_workers);
  */
 extern void read_file();
 
+/**
+ *  \brief Add integers to a fingerprint.
+ *
+ *  \param fingerprint contains the fingerprint
+ *  \param values contains the integers
+ *  \param n contains the number of integers
+ */
+extern void add_to_fingerprint(struct Fingerprint *fingerprint, int *values, long long n);
+
+/**
+ *  \brief Compare two fingerprints.
+ *
+ *  \return true if the fingerprints are equal, false otherwise.
+ */
+extern bool same_fingerprint(struct Fingerprint *a, struct Fingerprint *b);
+
 /**
  *  \brief Validation of final sequence.
  *
- *  Checks whether the final sequence is properly sorted or not.
+ *  Checks whether the final sequence is properly sorted and has the same integers as
+ *  the file, split among a number of threads.
  *
+ *  \param n_threads contains the number of threads
  */
-extern void validate();
+extern void validate(int n_threads);
 
 /**
  *  \brief Request for work.
  *
- *  Operation carried out by the workers.
+ *  Operation carried out by the workers. The worker takes work from its own deque,
+ *  steals it from another worker or blocks until there is work available.
+ *
+ *  \param worker_id contains the id of the worker
+ *  \param work will store the work to be done
+ *
+ *  \return true if work was assigned, false if all work is done.
  */
-extern void request_work();
+extern bool request_work(int worker_id, struct Work *work);
 
 /**
  *  \brief Sort a sequence.
  *
  *  Operation carried out by the workers.
  *
- *  \param id contains the id of the sequence to be sorted
+ *  \param worker_id contains the id of the worker
+ *  \param task contains the sort task
  */
-extern void sort_sequence(int id);
+extern void sort_sequence(int worker_id, struct Task *task);
 
 /**
- *  \brief Merge two sequences.
+ *  \brief Merge one part of two sequences.
  *
- *  Operation carried out by the workers. 
+ *  Operation carried out by the workers.
  *
- *  \param worker_id contains the worker id that was assigned to merge the subsequences
+ *  \param worker_id contains the id of the worker
+ *  \param task contains the merge task
+ *  \param part contains the part of the merge assigned to the worker
  */
-extern void merge_sequences(int worker_id);
+extern void merge_sequences(int worker_id, struct Task *task, int part);
 
 /**
- *  \brief Notify the distributor that work has been completed.
+ *  \brief Gather one block of the sorted records.
  *
- *  Operation carried out by the workers.
+ *  Operation carried out by the workers, once the (key, index) pairs are sorted.
+ *
+ *  \param worker_id contains the id of the worker
+ *  \param task contains the gather task
+ *  \param part contains the block of the sorted records assigned to the worker
+ */
+extern void gather_records(int worker_id, struct Task *task, int part);
+
+/**
+ *  \brief Notify that work has been completed.
  *
- *  \param id contains the worker id that has completed its task
+ *  Operation carried out by the workers. When the last part of a task is done, the
+ *  task that depends on it is pushed to the worker's deque once all its inputs are ready.
+ *
+ *  \param worker_id contains the id of the worker that has completed the work
+ *  \param work contains the completed work
  */
-extern void notify(int id);
+extern void notify(int worker_id, struct Work *work);
 
 /**
  *  \brief Divide the work between the workers.
  *
- *  Operation carried out by the distributor.
- * 
+ *  Operation carried out by the distributor. Builds the sort tasks and the merge tree.
+ *
  *  \param n_workers contains the number of workers
  */
 extern void divide_work(int n_workers);
 
 /**
- *  \brief Listening for workers' activity and handling their requests.
+ *  \brief Distribute the sort tasks and wait for the work to be done.
+ *
+ *  Operation carried out by the distributor. The file is read block by block and each
+ *  sort task is distributed as soon as its part of the sequence is read. The workers
+ *  stay available for another sort until finish_work is called.
  *
- *  Operation carried out by the distributor.
- * 
  *  \param n_workers contains the number of workers
  */
-extern void listen(int n_workers);
+extern void distribute_work(int n_workers);
 
 /**
- *  \brief Applies the Bitonic Sort algorithm to a subsequence of integers.
- *
- *  Operation carried out by the workers.
+ *  \brief Let the workers know that there are no more sorts.
  *
- *  \param val contains the subsequence of integers to be sorted
- *  \param N contains the size of the subsequence
+ *  Operation carried out by the distributor, the workers waiting for work terminate.
  */
-extern void bitonicSort(int *val, int N);
+extern void finish_work();
 
-#endif /* MONITOR_H */
\ No newline at end of file
+#endif /* MONITOR_H */
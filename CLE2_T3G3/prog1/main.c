@@ -137,7 +137,7 @@ int main(int argc, char *argv[]) {
 
           // structure that has file's chunk to process and the results of that processing 
           struct ChunkData *chunk_data = (struct ChunkData *)malloc(sizeof(struct ChunkData));
-          chunk_data->chunk = (int *)malloc(maxBytesPerChunk * sizeof(int));
+          chunk_data->chunk = (char *)malloc(maxBytesPerChunk * sizeof(char));
           chunk_data->nWords = 0; chunk_data->nWordsA = 0; chunk_data->nWordsE = 0;chunk_data->nWordsI = 0; chunk_data->nWordsO = 0;chunk_data->nWordsU = 0; chunk_data->nWordsY = 0;
           chunk_data->is_finished = false;
 
@@ -153,8 +153,8 @@ int main(int argc, char *argv[]) {
           printf("[rank %d] sending chunk data to worker %d\n", rank, worker);
           MPI_Send ((char *) chunk_data, sizeof(struct ChunkData), MPI_BYTE, worker, 0, MPI_COMM_WORLD); // MPI_Send with request
 
-          printf("[rank %d] sending list of integers to worker %d\n", rank, worker);
-          MPI_Send (chunk_data->chunk, chunk_data->chunk_size, MPI_INT, worker, 0, MPI_COMM_WORLD);      // the chunk buffer
+          printf("[rank %d] sending the text of the chunk to worker %d\n", rank, worker);
+          MPI_Send (chunk_data->chunk, chunk_data->chunk_size, MPI_CHAR, worker, 0, MPI_COMM_WORLD);      // the chunk buffer
 
           if (chunk_data->is_finished) {
             fclose(f); // close the file pointer
@@ -208,6 +208,10 @@ int main(int argc, char *argv[]) {
   
   } else {
     struct ChunkData *chunk_data = (struct ChunkData *)malloc(sizeof(struct ChunkData));
+    // text of the chunk, reused for every chunk; only the dispatcher knows the -m option, so it grows
+    // to the size of the largest chunk received
+    int chunk_capacity = maxBytesPerChunk;
+    char *chunk = (char *)malloc(chunk_capacity * sizeof(char));
 
     printf("[rank %d] waiting for work...\n", rank);
     while (true) {
@@ -217,18 +221,23 @@ int main(int argc, char *argv[]) {
       MPI_Recv(&all_work_done, 1, MPI_INT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
       if (all_work_done == 1) {
         printf("[rank %d] received message: All work done!\n", rank);
-        free(chunk_data->chunk);
+        free(chunk);
         free(chunk_data);
         break;
       }
     
-      // receive the chunk size and then the chunk (list of integers)
+      // receive the chunk size and then the chunk (text)
       MPI_Recv ((char *) chunk_data, sizeof (struct ChunkData), MPI_BYTE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
       printf("[rank %d] received chunk data from dispatcher!\n", rank);
 
-      int *chunk = (int *)malloc(chunk_data->chunk_size * sizeof(int));
-      MPI_Recv(chunk, chunk_data->chunk_size, MPI_INT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-      printf("[rank %d] received list of integers from dispatcher!\n", rank);
+      if (chunk_data->chunk_size > chunk_capacity) {
+        chunk_capacity = chunk_data->chunk_size;
+        free(chunk);
+        chunk = (char *)malloc(chunk_capacity * sizeof(char));
+      }
+
+      MPI_Recv(chunk, chunk_data->chunk_size, MPI_CHAR, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+      printf("[rank %d] received the text of the chunk from dispatcher!\n", rank);
 
       chunk_data->chunk = chunk;
 
@@ -310,5 +319,5 @@ void reset_struct(struct ChunkData *data) {
   data->is_finished = false;
   data->chunk_size = 0;
   data->nWords = 0; data->nWordsA = 0; data->nWordsE = 0; data->nWordsI = 0; data->nWordsO = 0; data->nWordsU = 0; data->nWordsY = 0;
-  memset(data->chunk, 0, new_size * sizeof(unsigned int));
+  memset(data->chunk, 0, new_size * sizeof(char));
 }
\ No newline at end of file
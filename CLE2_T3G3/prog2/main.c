@@ -20,6 +20,28 @@ static double get_delta_time(void);
 /** \brief print command usage */
 static void printUsage (char *cmdName);
 
+/** \brief MPI datatype of the elements (keys) of a type */
+static MPI_Datatype datatype_of (enum ElementType type);
+
+/** \brief merge the sorted subsequences of the processes in a binary tree */
+static void *tree_merge (void *subsequence, int length, int rank, int size, struct Kernels *kernels, MPI_Datatype datatype);
+
+/** \brief sort the blocks of the processes with a distributed bitonic sort */
+static void *bitonic_sort (void *subsequence, int *length, int block_size, int rank, int size, struct Kernels *kernels, MPI_Datatype datatype);
+
+/** \brief validate the blocks of the processes without gathering them */
+static void validate_blocks (void *subsequence, int length, int rank, int size, struct Kernels *kernels,
+                             struct Fingerprint *input_fingerprint, int dispatcher);
+
+/** \brief read the header of the input file and the subsequence of the process with MPI-IO */
+static bool read_input (int rank, int size, int dispatcher, void **subsequence, int *length);
+
+/** \brief write the blocks of the processes to the output file with MPI-IO */
+static void write_output (char *filename, void *subsequence, int length, int rank, int dispatcher);
+
+/** \brief combine the fingerprints of all processes in the dispatcher */
+static void reduce_fingerprint (struct Fingerprint *fingerprint, int dispatcher);
+
 
 int main(int argc, char *argv[]) {
 
@@ -32,223 +54,549 @@ int main(int argc, char *argv[]) {
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
   MPI_Comm_size(MPI_COMM_WORLD, &size);
 
-  /* This program requires at least 2 processes */
-  if (size < 2) {
-    fprintf(stderr, "Requires at least two processes.\n");
+  if (argc < 2) {
+    if (rank == dispatcher) printUsage(argv[0]);
     MPI_Finalize();
     return EXIT_FAILURE;
   }
 
-  printf("[rank %d] starting\n", rank);
+  // process command line arguments, the same in every process
+  char *filename = argv[1];     // binary file 
+  char *algorithm = "merge";    // sort algorithm
+  bool natural_runs = false;    // the subsequences are sorted by the bitonic sort
+  char *output_filename = NULL; // the sorted sequence is not written
+  int opt;                      // selected option
+
+  optind = 2;
+  do {
+    switch ((opt = getopt(argc, argv, "ha:s:o:"))) {
+
+      case 'a': // sort algorithm
+        if (strcmp(optarg, "merge") != 0 && strcmp(optarg, "bitonic") != 0) {
+          if (rank == dispatcher) {
+            fprintf(stderr, "%s: sort algorithm must be merge or bitonic\n", argv[0]);
+            printUsage(argv[0]);
+          }
+          MPI_Finalize();
+          return EXIT_FAILURE;
+        }
+        algorithm = optarg;
+        break;
+
+      case 's': // sort of the subsequences
+        if (strcmp(optarg, "bitonic") != 0 && strcmp(optarg, "runs") != 0) {
+          if (rank == dispatcher) {
+            fprintf(stderr, "%s: sort of the subsequences must be bitonic or runs\n", argv[0]);
+            printUsage(argv[0]);
+          }
+          MPI_Finalize();
+          return EXIT_FAILURE;
+        }
+        natural_runs = strcmp(optarg, "runs") == 0;
+        break;
+
+      case 'o': // output file
+        output_filename = optarg;
+        break;
+
+      case 'h': // help mode
+        if (rank == dispatcher) printUsage(argv[0]);
+        MPI_Finalize();
+        return EXIT_SUCCESS;
+
+      case '?': // invalid option
+        if (rank == dispatcher) {
+          fprintf(stderr, "%s: invalid option\n", argv[0]);
+          printUsage(argv[0]);
+        }
+        MPI_Finalize();
+        return EXIT_FAILURE;
+
+      case -1:
+        break;
+    }
 
-  if (rank == dispatcher) {
+  } while (opt != -1);
 
-    if (argc < 2) {
-      printUsage(argv[0]);
-      return 1;
-    }
+  printf("[rank %d] starting\n", rank);
+
+  // fingerprint of the integers of the file: each process computes the one of the subsequence it receives
+  struct Fingerprint fingerprint = {0, 0, 0};
 
+  if (rank == dispatcher) {
     // start counting the execution time
     (void) get_delta_time ();
+  }
 
-    int n_workers = size - 1;
-    char *filename = argv[1];     // binary file 
+  // struct that holds the header of the file and, in the dispatcher, the results
+  file = (struct File*)malloc(sizeof(struct File));
+  file->filename = filename;
+
+  // each process reads the header of the file and its subsequence
+  void *subsequence;
+  int subsequence_length;
+  if (!read_input(rank, size, dispatcher, &subsequence, &subsequence_length)) {
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+  printf("[rank %d] subsequence read\n", rank);
 
-    // struct that holds all the results and all the work that needs to be done
-    file = (struct File*)malloc(sizeof(struct File));
-    file->filename = filename;
-    file->file = NULL;
+  // every process sorts the elements with the kernels of their type
+  struct Kernels *kernels = file->kernels;
+  MPI_Datatype datatype = datatype_of(file->type);
+  long long words = kernels->element_size / sizeof(int);    // 32-bit words of an element
 
-    // read file (see this function in file sortInt.c)
-    read_file(file);
-    printf("[rank %d] file readed\n", rank);
+  // greatest size of a subsequence, the one of the dispatcher
+  int block_size = file->subsequences_length[0];
 
-    // divide the work among all available workers (see this function in file sortInt.c)
-    divide_work(file, n_workers);
-    printf("[rank %d] work divided\n", rank);
+  add_to_fingerprint(&fingerprint, (int *)subsequence, subsequence_length * words);
 
-    // send one subsequence of integers to each worker
-    for (int worker = 1; worker < size; worker++) {
+  // it's time to the sort task (see this function in file sortInt.c)
+  subsequence = sort_sequence(subsequence, subsequence_length, kernels, natural_runs);
 
-      printf("[rank %d] sending task to worker %d\n", rank, worker);
-      MPI_Send(&file->subsequences_length[ worker - 1 ], 1, MPI_INT, worker, 0, MPI_COMM_WORLD);    // send the subsequence size
-      MPI_Send(file->subsequences[ worker - 1 ], file->subsequences_length[ worker - 1 ], MPI_INT, worker, 0, MPI_COMM_WORLD);  // then send the subsequence
+  if (strcmp(algorithm, "bitonic") == 0) {
+    // compare-split with the other processes, each one ends with its block of the sorted sequence
+    subsequence = bitonic_sort(subsequence, &subsequence_length, block_size, rank, size, kernels, datatype);
+
+    reduce_fingerprint(&fingerprint, dispatcher);
+    validate_blocks(subsequence, subsequence_length, rank, size, kernels, &fingerprint, dispatcher);
+
+    // each process writes its block, at its position in the output file
+    if (output_filename != NULL) {
+      write_output(output_filename, subsequence, subsequence_length, rank, dispatcher);
     }
 
-    // receive the subsequence of integers sorted by the workers
-    for (int worker = 1; worker < size; worker++) {
-      MPI_Recv (file->subsequences[ worker - 1 ], file->subsequences_length[ worker - 1 ], MPI_INT, worker, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-      printf("[rank %d] received sorted subsequence from worker %d\n", rank, worker);
+    if (rank == dispatcher) {
+      float exec_time = get_delta_time();
+      printf("Execution time = %.6fs\n", exec_time);
     }
 
-    // it's time to merge all sorted subsequences
-    // while the list of subsequences is not equal to 1, that is, the whole sequence is ordered
-    while (file->all_subsequences_size != 1) {
-      int worker = 1;
+    free(subsequence);
+    MPI_Finalize();
 
-      // send two subsequences to the chosen worker to merge
-      for (int i = 0; i < file->all_subsequences_size - 1; i += 2) {
-        int *subsequence1 = file->subsequences[i];
-        int subsequence1_length = file->subsequences_length[i];
+    return EXIT_SUCCESS;
+  }
 
-        int *subsequence2 = file->subsequences[i + 1];
-        int subsequence2_length = file->subsequences_length[i + 1];
+  // merge with the other processes, the whole sequence ends in the dispatcher
+  subsequence = tree_merge(subsequence, subsequence_length, rank, size, kernels, datatype);
 
-        // first, we need to inform the worker that he will do a merge task
-        int merge_task = 1;
-        MPI_Send(&merge_task, 1, MPI_INT, worker, 0, MPI_COMM_WORLD);
+  reduce_fingerprint(&fingerprint, dispatcher);
 
-        printf("[rank %d] send subsequences to merge to worker %d!\n", rank, worker);
-        MPI_Send(&subsequence1_length, 1, MPI_INT, worker, 0, MPI_COMM_WORLD);            // send the subsequence1 size
-        MPI_Send(subsequence1, subsequence1_length, MPI_INT, worker, 0, MPI_COMM_WORLD);  // then send the subsequence1
+  if (rank == dispatcher) {
+    // update struct
+    file->sequence = subsequence;
+    subsequence_length = file->size;
 
-        MPI_Send(&subsequence2_length, 1, MPI_INT, worker, 0, MPI_COMM_WORLD);            // send the subsequence2 size
-        MPI_Send(subsequence2, subsequence2_length, MPI_INT, worker, 0, MPI_COMM_WORLD);  // then send the subsequence2
+    // check if the sequence is sorted and has the elements of the file (see this function in file sortInt.c)
+    printf("[rank %d] ", rank);
+    validate(file, &fingerprint);
+  } else {
+    subsequence_length = 0;
+  }
 
-        worker++;   // next worker
-      }
+  // the dispatcher has the whole sequence to write, the other processes take part with nothing
+  if (output_filename != NULL) {
+    write_output(output_filename, subsequence, subsequence_length, rank, dispatcher);
+  }
 
-      // inform the other workers that they don't need to fo a merge task 
-      for (int i = worker; i < size; i++) {
-        int merge_task = 0;
-        MPI_Send(&merge_task, 1, MPI_INT, i, 0, MPI_COMM_WORLD);
-      }
+  if (rank == dispatcher) {
+    float exec_time = get_delta_time();
+    printf("Execution time = %.6fs\n", exec_time);
+  }
 
-      // resize the new subsequences array
-      int new_size = worker - 1;
-      if (file->all_subsequences_size % 2 != 0) {
-        new_size = worker;
-      }
+  free(subsequence);
 
-      int *new_subsequences_length = (int *)malloc(new_size * sizeof(int));
-      int **new_subsequences = (int **)malloc(new_size * sizeof(int *));
-      int new_subsequences_size = 0;
+  MPI_Finalize();
 
-      // receive the merged sequence by workers
-      for (int i = 1; i < worker; i++) {
-        int merged_sequence_size;
-        MPI_Recv(&merged_sequence_size, 1, MPI_INT, i, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+  return EXIT_SUCCESS;
+}
 
-        int *merged_subsequence = (int*)malloc(sizeof(int) * merged_sequence_size);
-        MPI_Recv (merged_subsequence, merged_sequence_size, MPI_INT, i, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-        printf("[rank %d] received merged subsequence from worker %d\n", rank, i);
 
-        new_subsequences[i - 1] = merged_subsequence;
-        new_subsequences_length[i - 1] = merged_sequence_size;
-        new_subsequences_size++;
-      }
+/**
+ *  \brief Get the process time that has elapsed since last call of this time.
+ *
+ *  \return process elapsed time
+ */
+static double get_delta_time(void) {
+  static struct timespec t0, t1;
 
-      // if the size of sequences to be merged is odd, the one that was left out is the last in the new sequence
-      if (file->all_subsequences_size % 2 != 0) {
-        new_subsequences[new_subsequences_size] = file->subsequences[file->all_subsequences_size - 1];
-        new_subsequences_length[new_subsequences_size] = file->subsequences_length[file->all_subsequences_size - 1];
-        new_subsequences_size++;
-      }
+  t0 = t1;
+  if(clock_gettime (CLOCK_MONOTONIC, &t1) != 0) {
+    perror ("clock_gettime");
+    exit(1);
+  }
+  return (double) (t1.tv_sec - t0.tv_sec) + 1.0e-9 * (double) (t1.tv_nsec - t0.tv_nsec);
+}
 
-      free(file->subsequences);
-      free(file->subsequences_length);
 
-      // replace to the new subsequences list
-      file->all_subsequences_size = new_subsequences_size;
-      file->subsequences = new_subsequences;
-      file->subsequences_length = new_subsequences_length;
+/**
+ *  \brief Merge the sorted subsequences of the processes in a binary tree.
+ *
+ *  The processes are merged pairwise: in the round of distance d, every process whose
+ *  rank is a multiple of 2d receives the subsequence of the process d after it and merges
+ *  it with its own, while that one is done. All the pairs of a round merge at the same
+ *  time and the data only goes through the dispatcher (rank 0) in the last round, where
+ *  it merges the two halves of the sequence.
+ *
+ *  \param subsequence contains the sorted subsequence of the process
+ *  \param length contains the size of the subsequence
+ *  \param rank contains the rank of the process
+ *  \param size contains the number of processes
+ *  \param kernels contains the kernels of the type of the elements
+ *  \param datatype contains the MPI datatype of the elements
+ *
+ *  \return the merged subsequence, the whole sequence in the dispatcher.
+ */
+static void *tree_merge(void *subsequence, int length, int rank, int size, struct Kernels *kernels, MPI_Datatype datatype) {
+  for (int distance = 1; distance < size; distance *= 2) {
+    if (rank % (2 * distance) != 0) {
+      // merged by the process distance before this one
+      MPI_Send(subsequence, length, datatype, rank - distance, 0, MPI_COMM_WORLD);
+      printf("[rank %d] send sorted subsequence to rank %d!\n", rank, rank - distance);
+      return subsequence;
     }
 
-    // send message to all workers that the work is all done
-    for (int worker = 1; worker < size; worker++) {
-      int merge_task = -1;
-      MPI_Send(&merge_task, 1, MPI_INT, worker, 0, MPI_COMM_WORLD);
-    }
+    int partner = rank + distance;
+    if (partner >= size) continue;
 
-    // update struct
-    file->sequence = file->subsequences[0];
+    // the size of the subsequence of the partner comes with its message
+    MPI_Status status;
+    int partner_length;
+    MPI_Probe(partner, 0, MPI_COMM_WORLD, &status);
+    MPI_Get_count(&status, datatype, &partner_length);
 
-    // check if the sequence is sorted or not (see this function in file sortInt.c)
-    printf("[rank %d] ", rank);
-    validate(file);
+    void *partner_subsequence = malloc(partner_length * kernels->element_size);
+    MPI_Recv(partner_subsequence, partner_length, datatype, partner, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    printf("[rank %d] received sorted subsequence from rank %d!\n", rank, partner);
 
-    float exec_time = get_delta_time();
-    printf("Execution time = %.6fs\n", exec_time);
+    // (see this function in file sortInt.c)
+    void *merged_subsequence = merge_sequences(subsequence, length, partner_subsequence, partner_length, kernels);
+    free(subsequence);
+    free(partner_subsequence);
 
-  } else {
+    subsequence = merged_subsequence;
+    length += partner_length;
+  }
 
-    // receive the subsequence size and then the subsequence of integers from dispatcher  
-    int subsequence_length;
-    MPI_Recv(&subsequence_length, 1, MPI_INT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+  return subsequence;
+}
 
-    int *subsequence = (int *)malloc(subsequence_length * sizeof(int));
-    MPI_Recv(subsequence, subsequence_length, MPI_INT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-    printf("[rank %d] received subsequence from dispatcher!\n", rank);
 
-    // it's time to the sort task (see this function in file sortInt.c)
-    subsequence = sort_sequence(subsequence, subsequence_length);
+/**
+ *  \brief Sort the blocks of the processes with a distributed bitonic sort.
+ *
+ *  Each process holds a sorted block and the processes are the wires of a bitonic sorting
+ *  network, in the variant whose comparators all put the smallest elements in the lower
+ *  rank: for each size k of the sequences merged, the first step pairs each rank with its
+ *  mirror in its group of k ranks, the next ones with the rank j = k/4, ..., 1 away. A
+ *  comparator is a compare-split: the pair exchanges its blocks with MPI_Sendrecv and the
+ *  lower rank keeps the smallest block_size elements, the other one the rest.
+ *
+ *  The blocks are padded up to block_size elements, and the number of processes up to a
+ *  power of two, with sentinels greater than any element, only at the logical level: they
+ *  are never sent, a block just keeps the elements of the lower block_size positions
+ *  that are not sentinels. A rank paired with a process past the last one holds the lower
+ *  block of the pair, so it keeps its own elements and skips the step.
+ *
+ *  \param subsequence contains the sorted block of the process, with room for block_size elements
+ *  \param length contains the size of the block, updated with the size of the new block
+ *  \param block_size contains the greatest size of a block
+ *  \param rank contains the rank of the process
+ *  \param size contains the number of processes
+ *  \param kernels contains the kernels of the type of the elements
+ *  \param datatype contains the MPI datatype of the elements
+ *
+ *  \return block of the sorted sequence of the process.
+ */
+static void *bitonic_sort(void *subsequence, int *length, int block_size, int rank, int size, struct Kernels *kernels, MPI_Datatype datatype) {
+  void *other = malloc(block_size * kernels->element_size);
+  void *kept = malloc(block_size * kernels->element_size);
+
+  int logical_size = 1;
+  while (logical_size < size) logical_size *= 2;
+
+  for (int k = 2; k <= logical_size; k *= 2) {
+    for (int j = k / 2; j >= 1; j /= 2) {
+      int partner = (j == k / 2) ? (rank ^ (k - 1)) : (rank ^ j);
+      if (partner >= size) continue;
+
+      // exchange the blocks, the size of the block of the partner comes with its message
+      MPI_Status status;
+      int other_length;
+      MPI_Sendrecv(subsequence, *length, datatype, partner, 0,
+                   other, block_size, datatype, partner, 0, MPI_COMM_WORLD, &status);
+      MPI_Get_count(&status, datatype, &other_length);
+
+      // the elements among the lower or the upper block_size positions of the pair
+      bool lower = rank < partner;
+      int total = *length + other_length;
+      int kept_length = lower ? (total < block_size ? total : block_size) : (total > block_size ? total - block_size : 0);
+
+      kernels->merge_split(subsequence, *length, other, other_length, kept, kept_length, lower);
+
+      void *temp = subsequence;
+      subsequence = kept;
+      kept = temp;
+      *length = kept_length;
+    }
+  }
 
-    // send the sorted subsequence to dispatcher
-    MPI_Send(subsequence, subsequence_length, MPI_INT, 0, 0, MPI_COMM_WORLD);
-    printf("[rank %d] send sorted subsequence to dispatcher!\n", rank);
+  free(other);
+  free(kept);
 
-    // it's time to the merge task
-    int merge_task = 0;
-    while (true) {
-      // receives a message from the dispatcher...
-      MPI_Recv(&merge_task, 1, MPI_INT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+  return subsequence;
+}
 
-      // ... if it is equal to -1, it means that all work is done
-      if (merge_task == -1) break;
 
-      // ... if it is equal to 1, it means that this worker needs to do a merge task
-      if (merge_task) {
+/**
+ *  \brief Validate the blocks of the processes without gathering them.
+ *
+ *  Each process checks the order of its block and computes its fingerprint. The
+ *  dispatcher gathers, from every process, the size of its block, the position of its
+ *  first pair out of order, that pair and the first and last elements of the block, so
+ *  it checks the order across the blocks too.
+ *
+ *  \param subsequence contains the block of the process
+ *  \param length contains the size of the block
+ *  \param rank contains the rank of the process
+ *  \param size contains the number of processes
+ *  \param kernels contains the kernels of the type of the elements
+ *  \param input_fingerprint contains the fingerprint of the integers of the file, in the dispatcher
+ *  \param dispatcher contains the rank of the dispatcher
+ */
+static void validate_blocks(void *subsequence, int length, int rank, int size, struct Kernels *kernels,
+                            struct Fingerprint *input_fingerprint, int dispatcher) {
+  size_t element_size = kernels->element_size;
 
-        // receive two subsequences from dispatcher to merge
-        int subsequence1_size;
-        MPI_Recv(&subsequence1_size, 1, MPI_INT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+  struct Fingerprint output_fingerprint = {0, 0, 0};
+  add_to_fingerprint(&output_fingerprint, (int *)subsequence, (long long)length * (element_size / sizeof(int)));
+  reduce_fingerprint(&output_fingerprint, dispatcher);
 
-        int *subsequence1 = (int *)malloc(subsequence1_size * sizeof(int));
-        MPI_Recv(subsequence1, subsequence1_size, MPI_INT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+  // size of the block and its first pair out of order, then the first and last elements and that pair
+  int summary[2] = { length, kernels->first_unsorted(subsequence, 0, length - 1) };
+  char *ends = calloc(4, element_size);
 
-        int subsequence2_size;
-        MPI_Recv(&subsequence2_size, 1, MPI_INT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+  if (length > 0) {
+    memcpy(ends, subsequence, element_size);
+    memcpy(ends + element_size, (char *)subsequence + (size_t)(length - 1) * element_size, element_size);
+  }
+  if (summary[1] >= 0) {
+    memcpy(ends + 2 * element_size, (char *)subsequence + (size_t)summary[1] * element_size, 2 * element_size);
+  }
 
-        int *subsequence2 = (int *)malloc(subsequence2_size * sizeof(int));
-        MPI_Recv(subsequence2, subsequence2_size, MPI_INT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-        
-        printf("[rank %d] received subsequences to merge from dispatcher!\n", rank);
+  int *summaries = NULL;
+  char *all_ends = NULL;
+  if (rank == dispatcher) {
+    summaries = malloc(2 * size * sizeof(int));
+    all_ends = malloc(4 * size * element_size);
+  }
 
-        // merge the two subsequences received (see this function in file sortInt.c)
-        int merged_sequence_size = (subsequence1_size + subsequence2_size);
+  MPI_Gather(summary, 2, MPI_INT, summaries, 2, MPI_INT, dispatcher, MPI_COMM_WORLD);
+  MPI_Gather(ends, 4 * element_size, MPI_BYTE, all_ends, 4 * element_size, MPI_BYTE, dispatcher, MPI_COMM_WORLD);
 
-        int *merged_subsequence = (int *)malloc(merged_sequence_size  * sizeof(int));
-        merged_subsequence = merge_sequences(subsequence1, subsequence1_size, subsequence2, subsequence2_size);
+  if (rank == dispatcher) {
+    int first_error = -1;
+    void *pair = NULL;
+    char *boundary = malloc(2 * element_size);    // last element of a block and first element of the next one
+    char *last = NULL;
+    int offset = 0;
+
+    for (int i = 0; i < size && first_error < 0; i++) {
+      char *block_ends = all_ends + 4 * i * element_size;
+      if (summaries[2 * i] == 0) continue;
+
+      if (last != NULL) {
+        memcpy(boundary, last, element_size);
+        memcpy(boundary + element_size, block_ends, element_size);
+        if (kernels->first_unsorted(boundary, 0, 1) == 0) {
+          first_error = offset - 1;
+          pair = boundary;
+          break;
+        }
+      }
 
-        // send the merged subsequence to dispatcher
-        MPI_Send(&merged_sequence_size, 1, MPI_INT, 0, 0, MPI_COMM_WORLD);    // send the subsequence1 size
-        MPI_Send(merged_subsequence, merged_sequence_size, MPI_INT, 0, 0, MPI_COMM_WORLD);
-        printf("[rank %d] send merged subsequence to dispatcher!\n", rank);
+      if (summaries[2 * i + 1] >= 0) {
+        first_error = offset + summaries[2 * i + 1];
+        pair = block_ends + 2 * element_size;
       }
+
+      last = block_ends + element_size;
+      offset += summaries[2 * i];
     }
-    
+
+    printf("[rank %d] ", rank);
+    print_validation(file, first_error, pair, &output_fingerprint, input_fingerprint);
+
+    free(boundary);
+    free(summaries);
+    free(all_ends);
   }
 
-  MPI_Finalize();
+  free(ends);
+}
 
-  return EXIT_SUCCESS;
+
+/**
+ *  \brief Read the header of the input file and the subsequence of the process with MPI-IO.
+ *
+ *  Every process reads the header of the file, divides the work in the same way and
+ *  reads its own contiguous part of the file, all at the same time with a collective
+ *  read, so no process holds more than its part. The floating-point numbers are
+ *  transformed into their keys.
+ *
+ *  \param rank contains the rank of the process
+ *  \param size contains the number of processes
+ *  \param dispatcher contains the rank of the dispatcher, which reports the errors
+ *  \param subsequence contains the subsequence read, with room for the greatest subsequence
+ *  \param length contains the size of the subsequence read
+ *
+ *  \return true if the file was read, false if its header is not valid.
+ */
+static bool read_input(int rank, int size, int dispatcher, void **subsequence, int *length) {
+  MPI_File input;
+  MPI_Offset file_size;
+  MPI_Status status;
+
+  if (MPI_File_open(MPI_COMM_WORLD, file->filename, MPI_MODE_RDONLY, MPI_INFO_NULL, &input) != MPI_SUCCESS) {
+    if (rank == dispatcher) printf("Error opening the file\n");
+    return false;
+  }
+
+  // the first bytes of the file, fewer if the file is shorter than the longest header
+  char bytes[MAX_HEADER_SIZE];
+  int n_bytes = 0;
+  if (MPI_File_get_size(input, &file_size) != MPI_SUCCESS ||
+      MPI_File_read_at(input, 0, bytes, MAX_HEADER_SIZE, MPI_BYTE, &status) != MPI_SUCCESS) {
+    printf("[rank %d] Error reading the file\n", rank);
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  }
+  MPI_Get_count(&status, MPI_BYTE, &n_bytes);
+
+  // (see this function in file sortInt.c)
+  if (!read_header(file, bytes, n_bytes, file_size, rank == dispatcher)) {
+    MPI_File_close(&input);
+    return false;
+  }
+
+  // divide the work among all processes, the dispatcher included (see this function in file sortInt.c)
+  divide_work(file, size);
+
+  size_t element_size = file->kernels->element_size;
+  int block_size = file->subsequences_length[0];
+
+  *length = file->subsequences_length[rank];
+  *subsequence = malloc((block_size > 0 ? block_size : 1) * element_size);    // room for a block of the bitonic sort
+
+  if (MPI_File_read_at_all(input, file->header_size + (MPI_Offset)file->subsequences_offset[rank] * element_size,
+                           *subsequence, *length, datatype_of(file->type), MPI_STATUS_IGNORE) != MPI_SUCCESS ||
+      MPI_File_close(&input) != MPI_SUCCESS) {
+    printf("[rank %d] Error reading the file\n", rank);
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  }
+
+  // (see this function in file sortInt.c)
+  to_keys(file->type, *subsequence, *length);
+
+  return true;
 }
 
 
 /**
- *  \brief Get the process time that has elapsed since last call of this time.
+ *  \brief Write the blocks of the processes to the output file with MPI-IO.
  *
- *  \return process elapsed time
+ *  The file has the same header as the input file, written by the dispatcher, followed by
+ *  the blocks of the processes in the order of their ranks: each process finds the
+ *  position of its block from the sizes of the blocks before it (MPI_Exscan) and all
+ *  of them write at the same time with a collective write, so nothing is gathered.
+ *
+ *  \param filename contains the name of the output file
+ *  \param subsequence contains the block of the process, keys that are transformed back into elements
+ *  \param length contains the size of the block
+ *  \param rank contains the rank of the process
+ *  \param dispatcher contains the rank of the dispatcher
  */
-static double get_delta_time(void) {
-  static struct timespec t0, t1;
+static void write_output(char *filename, void *subsequence, int length, int rank, int dispatcher) {
+  MPI_File output;
+  size_t element_size = file->kernels->element_size;
+  long long position = 0;
+  long long block_length = length;
+
+  MPI_Exscan(&block_length, &position, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+  if (rank == dispatcher) position = 0;    // the result of MPI_Exscan is undefined in rank 0
+
+  if (MPI_File_open(MPI_COMM_WORLD, filename, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &output) != MPI_SUCCESS) {
+    if (rank == dispatcher) printf("Error opening the file %s\n", filename);
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  }
 
-  t0 = t1;
-  if(clock_gettime (CLOCK_MONOTONIC, &t1) != 0) {
-    perror ("clock_gettime");
-    exit(1);
+  // a previous, longer, file with the same name is truncated
+  int status = MPI_File_set_size(output, file->header_size + (long long)file->size * element_size);
+
+  if (rank == dispatcher && status == MPI_SUCCESS) {
+    char header[MAX_HEADER_SIZE];
+    int first = file->typed_header ? TYPED_HEADER_MAGIC : file->size;
+    int type = file->type;
+    long long size = file->size;
+
+    memcpy(header, &first, sizeof(int));
+    memcpy(header + sizeof(int), &type, sizeof(int));
+    memcpy(header + 2 * sizeof(int), &size, sizeof(long long));
+    status = MPI_File_write_at(output, 0, header, file->header_size, MPI_BYTE, MPI_STATUS_IGNORE);
   }
-  return (double) (t1.tv_sec - t0.tv_sec) + 1.0e-9 * (double) (t1.tv_nsec - t0.tv_nsec);
+
+  // (see this function in file sortInt.c)
+  from_keys(file->type, subsequence, length);
+
+  if (MPI_File_write_at_all(output, file->header_size + position * element_size, subsequence, length, datatype_of(file->type),
+                            MPI_STATUS_IGNORE) != MPI_SUCCESS || status != MPI_SUCCESS ||
+      MPI_File_close(&output) != MPI_SUCCESS) {
+    printf("[rank %d] Error writing the file %s\n", rank, filename);
+    MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+  }
+}
+
+
+/**
+ *  \brief MPI datatype of the elements of a type.
+ *
+ *  The floating-point numbers travel as their keys, unsigned integers of the same size.
+ *
+ *  \param type contains the type of the elements
+ *
+ *  \return MPI datatype of the elements (keys) of the type.
+ */
+static MPI_Datatype datatype_of(enum ElementType type) {
+  switch (type) {
+    case INT32:   return MPI_INT;
+    case UINT32:  return MPI_UNSIGNED;
+    case INT64:   return MPI_LONG_LONG;
+    case UINT64:  return MPI_UNSIGNED_LONG_LONG;
+    case FLOAT32: return MPI_UNSIGNED;
+    case FLOAT64: return MPI_UNSIGNED_LONG_LONG;
+  }
+  return MPI_INT;
+}
+
+
+/**
+ *  \brief Combine the fingerprints of all processes in the dispatcher.
+ *
+ *  The sums are added and the parities are xored, modulo 2^64.
+ *
+ *  \param fingerprint contains the fingerprint of the process, the combined one in the dispatcher
+ *  \param dispatcher contains the rank of the dispatcher
+ */
+static void reduce_fingerprint(struct Fingerprint *fingerprint, int dispatcher) {
+  unsigned long long sums[2] = { fingerprint->sum, fingerprint->hash_sum };
+  unsigned long long total_sums[2];
+  unsigned long long total_parity;
+
+  MPI_Reduce(sums, total_sums, 2, MPI_UNSIGNED_LONG_LONG, MPI_SUM, dispatcher, MPI_COMM_WORLD);
+  MPI_Reduce(&fingerprint->parity, &total_parity, 1, MPI_UNSIGNED_LONG_LONG, MPI_BXOR, dispatcher, MPI_COMM_WORLD);
+
+  fingerprint->sum = total_sums[0];
+  fingerprint->hash_sum = total_sums[1];
+  fingerprint->parity = total_parity;
 }
 
 
@@ -261,5 +609,12 @@ static double get_delta_time(void) {
  */
 
 static void printUsage(char *cmdName) {
-  fprintf (stderr, "\nSynopsis: %s filename \n", cmdName);
+  fprintf (stderr, "\nSynopsis: %s filename [OPTIONS]\n"
+           "  OPTIONS:\n"
+           "  -a algorithm   --- set the sort algorithm: merge (tree of merges into rank 0) or bitonic\n"
+           "                     (distributed bitonic sort, every rank keeps a block of the sorted sequence)\n"
+           "                     (default: merge)\n"
+           "  -s sort        --- set the sort of the subsequences: bitonic, or runs to merge their natural runs (default: bitonic)\n"
+           "  -o filename    --- write the sorted sequence to filename, in the format of the input file\n"
+           "  -h             --- print this help\n", cmdName);
 }
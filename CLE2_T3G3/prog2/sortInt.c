@@ -7,54 +7,196 @@
 
 #include "sortInt.h"
 
+/** \brief minimum number of elements of a natural run, shorter runs are extended by insertion sort */
+#define MIN_RUN 32
+
+/* kernels of the integers */
+#define ELEMENT int
+#define KERNEL(name) name##_int
+#include "sortKernels.h"
+#undef ELEMENT
+#undef KERNEL
+
+/* kernels of the unsigned integers and of the transformed floats */
+#define ELEMENT unsigned int
+#define KERNEL(name) name##_u32
+#include "sortKernels.h"
+#undef ELEMENT
+#undef KERNEL
+
+/* kernels of the 64-bit integers */
+#define ELEMENT long long
+#define KERNEL(name) name##_i64
+#include "sortKernels.h"
+#undef ELEMENT
+#undef KERNEL
+
+/* kernels of the 64-bit unsigned integers and of the transformed doubles */
+#define ELEMENT unsigned long long
+#define KERNEL(name) name##_u64
+#include "sortKernels.h"
+#undef ELEMENT
+#undef KERNEL
+
 
 /**
- *  \brief Read the file.
+ *  \brief Kernels of a type of element.
  *
- *  Reads a binary file and stores its content in an array of integers.
+ *  \param type contains the type of the elements
  *
+ *  \return kernels that sort the elements (or their keys, for floating-point numbers).
  */
-void read_file(struct File *file) {
-    // Open binary file for reading
-    file->file = fopen(file->filename, "rb");
-    
-    if (file->file == NULL) {
-        printf("Error opening the file\n");
-        exit(EXIT_FAILURE);
+struct Kernels *kernels_of(enum ElementType type) {
+    switch (type) {
+        case INT32:   return &kernels_int;
+        case UINT32:  return &kernels_u32;
+        case INT64:   return &kernels_i64;
+        case UINT64:  return &kernels_u64;
+        case FLOAT32: return &kernels_u32;
+        case FLOAT64: return &kernels_u64;
     }
+    return NULL;
+}
 
-    // Read the header of the binary file
-    if (fread(&file->size, sizeof(int), 1, file->file) != 1) {
-        printf("Error reading the file\n");
-        exit(EXIT_FAILURE);
+/**
+ *  \brief Transform floating-point numbers into keys with the same total order.
+ *
+ *  The sign bit of the positive numbers is set and all the bits of the negative ones are
+ *  flipped, so the keys, as unsigned integers, are in the order -NaN, -inf, negative
+ *  numbers, -0, +0, positive numbers, +inf and NaN. Other types are their own keys.
+ *
+ *  \param type contains the type of the elements
+ *  \param values contains the elements
+ *  \param n contains the number of elements
+ */
+void to_keys(enum ElementType type, void *values, int n) {
+    if (type == FLOAT32) {
+        unsigned int *keys = (unsigned int *)values;
+        for (int i = 0; i < n; i++) keys[i] ^= (keys[i] >> 31) ? 0xffffffffu : 0x80000000u;
+
+    } else if (type == FLOAT64) {
+        unsigned long long *keys = (unsigned long long *)values;
+        for (int i = 0; i < n; i++) keys[i] ^= (keys[i] >> 63) ? ~0ULL : 0x8000000000000000ULL;
     }
+}
 
-    file->sequence = (int*)malloc(file->size * sizeof(int));
+/**
+ *  \brief Transform keys back into the floating-point numbers they came from.
+ *
+ *  \param type contains the type of the elements
+ *  \param values contains the keys
+ *  \param n contains the number of keys
+ */
+void from_keys(enum ElementType type, void *values, int n) {
+    if (type == FLOAT32) {
+        unsigned int *keys = (unsigned int *)values;
+        for (int i = 0; i < n; i++) keys[i] ^= (keys[i] >> 31) ? 0x80000000u : 0xffffffffu;
+
+    } else if (type == FLOAT64) {
+        unsigned long long *keys = (unsigned long long *)values;
+        for (int i = 0; i < n; i++) keys[i] ^= (keys[i] >> 63) ? 0x8000000000000000ULL : ~0ULL;
+    }
+}
 
-    // Read the contents of the file
-    int num;
-    int i = 0;
-    while(fread(&num, sizeof(int), 1, file->file) == 1) {
-        file->sequence[i] = num;
-        i++;
+/**
+ *  \brief Print an element of the sequence.
+ *
+ *  \param file contains the struct File that have all the information needed
+ *  \param values contains the elements (keys, for floating-point numbers)
+ *  \param i contains the position of the element
+ */
+static void print_element(struct File *file, void *values, int i) {
+    union { int i32; unsigned int u32; long long i64; unsigned long long u64; float f32; double f64; } element;
+    size_t element_size = file->kernels->element_size;
+
+    memcpy(&element, (char *)values + i * element_size, element_size);
+    from_keys(file->type, &element, 1);
+
+    switch (file->type) {
+        case INT32:   printf("%d", element.i32); break;
+        case UINT32:  printf("%u", element.u32); break;
+        case INT64:   printf("%lld", element.i64); break;
+        case UINT64:  printf("%llu", element.u64); break;
+        case FLOAT32: printf("%g", element.f32); break;
+        case FLOAT64: printf("%g", element.f64); break;
     }
-   
-    // Close the file
-    fclose(file->file);
+}
+
+
+/**
+ *  \brief Read the header of the file.
+ *
+ *  Reads the type and the number of elements of the file from its first bytes and
+ *  checks them against the size of the file.
+ *
+ *  \param file contains the struct File that have all the information needed
+ *  \param bytes contains the first bytes of the file
+ *  \param n_bytes contains the number of bytes read, at most MAX_HEADER_SIZE
+ *  \param file_size contains the number of bytes of the file
+ *  \param report contains true to print why the header is not valid
+ *
+ *  \return true if the header is valid, false otherwise.
+ */
+bool read_header(struct File *file, char *bytes, int n_bytes, long long file_size, bool report) {
+    int first;
+    long long size;
+
+    if (n_bytes < (int)sizeof(int)) {
+        if (report) printf("Error reading the file\n");
+        return false;
+    }
+
+    memcpy(&first, bytes, sizeof(int));
+    file->typed_header = (first == TYPED_HEADER_MAGIC);
+    file->type = INT32;
+    file->header_size = sizeof(int);
+    size = first;
+
+    if (file->typed_header) {
+        // type of the elements and 64-bit number of elements
+        int type;
+        if (n_bytes < (int)MAX_HEADER_SIZE) {
+            if (report) printf("Error reading the file\n");
+            return false;
+        }
+        memcpy(&type, bytes + sizeof(int), sizeof(int));
+        memcpy(&size, bytes + 2 * sizeof(int), sizeof(long long));
+
+        if (type < INT32 || type > FLOAT64) {
+            if (report) printf("Error: unknown type of elements (%d) in the header of the file\n", type);
+            return false;
+        }
+
+        file->type = (enum ElementType)type;
+        file->header_size = MAX_HEADER_SIZE;
+    }
+
+    file->kernels = kernels_of(file->type);
+
+    // the header must match the number of elements in the file
+    if (size < 0 || size > INT_MAX || file_size != file->header_size + (long long)file->kernels->element_size * size) {
+        if (report) printf("Error: the header of the file (%lld elements) does not match its size\n", size);
+        return false;
+    }
+
+    file->size = (int)size;
+
+    return true;
 }
 
 /**
  *  \brief Divide the work between the workers.
  *
- *  Operation carried out by the dispatcher.
+ *  Operation carried out by every process. The sizes of the subsequences differ by
+ *  one at most, the first ones are the greatest.
  * 
  *  \param file contains the struct File that have all the information needed
  *  \param n contains the number of parts that the sequence needs to be divided
  */
 void divide_work(struct File *file, int n) {
 
-    file->subsequences = (int **)malloc(n * sizeof(int *));
     file->subsequences_length = (int *)malloc(n * sizeof(int));
+    file->subsequences_offset = (int *)malloc(n * sizeof(int));
 
     int part_size = file->size / n;
     
@@ -63,21 +205,11 @@ void divide_work(struct File *file, int n) {
     for (int i = 0; i < n; i++) {
         int end = start + part_size + (i < remainder ? 1 : 0);
 
-        int *subsequence = (int *)malloc((end - start) * sizeof(int));
-        int size = (end - start);
-
-        int k = 0;
-        for (int j = start; j < end; j++) {
-            subsequence[k] = file->sequence[j];
-            k++;
-        }
+        file->subsequences_length[i] = (end - start);
+        file->subsequences_offset[i] = start;
 
         start = end;
-        file->subsequences[i] = subsequence;
-        file->subsequences_length[i] = size;
     }
-
-    file->all_subsequences_size = n;
 }
 
 
@@ -86,142 +218,125 @@ void divide_work(struct File *file, int n) {
  *
  *  Operation carried out by the workers.
  *
- *  \param subsequence contains the subsequence of integers that needs to be sorted
+ *  \param subsequence contains the subsequence of elements that needs to be sorted
  *  \param size contains the size of the subsequence
+ *  \param kernels contains the kernels of the type of the elements
+ *  \param natural_runs contains true to merge the natural runs of the subsequence, false for the bitonic sort
  */
-int * sort_sequence(int *subsequence, int size) {
-    bitonicSort(subsequence, size);
-    return subsequence;
-}
-
-void compareAndPossibleSwap(int *val, int i, int j, int dir) {
-    if ((val[i] > val[j]) == dir) {
-        int temp = val[i];
-        val[i] = val[j];
-        val[j] = temp;
-    }
-}
-
-void bitonicMerge(int *val, int low, int cnt, int dir) {
-    if (cnt > 1) {
-        int k = cnt / 2;
-        for (int i = low; i < low + k; i++) {
-            compareAndPossibleSwap(val, i, i + k, dir);
-        }
-        bitonicMerge(val, low, k, dir);
-        bitonicMerge(val, low + k, k, dir);
+void * sort_sequence(void *subsequence, int size, struct Kernels *kernels, bool natural_runs) {
+    if (natural_runs) {
+        void *buffer = malloc(size * kernels->element_size);
+        kernels->sort_runs(subsequence, size, buffer);
+        free(buffer);
+    } else {
+        kernels->sort(subsequence, size);
     }
+    return subsequence;
 }
 
-void bitonicSortRecursive(int *val, int low, int cnt, int dir) {
-    if (cnt > 1) {
-        int k = cnt / 2;
-        bitonicSortRecursive(val, low, k, !dir);
-        bitonicSortRecursive(val, low + k, k, dir);
-        bitonicMerge(val, low, cnt, dir);
-    }
-}
 
 /**
- *  \brief Applies the Bitonic Sort algorithm to a subsequence of integers.
+ *  \brief Merge two sequences.
  *
- *  Operation carried out by the workers.
+ *  Operation carried out by the workers. 
  *
- *  \param val contains the subsequence of integers to be sorted
- *  \param N contains the size of the subsequence
+ *  \param subsequence1 contains the first subsequence1 of elements that needs to be merged
+ *  \param size1 contains the size of the subsequence1
+ *  \param subsequence2 contains the second subsequence of elements that needs to be merged
+ *  \param size2 contains the size of the subsequence2
+ *  \param kernels contains the kernels of the type of the elements
  */
-void bitonicSort(int *val, int N) {
-    int size = 1;
-    while (size < N) {
-        size <<= 1;
-    }
-
-    int *padded_val = (int *)malloc(size * sizeof(int));
-    for (int i = 0; i < N; i++) {
-        padded_val[i] = val[i];
-    }
-    for (int i = N; i < size; i++) {
-        padded_val[i] = INT_MAX;
-    }
-
-    bitonicSortRecursive(padded_val, 0, size, 1);
+void * merge_sequences(void *subsequence1, int size1, void *subsequence2, int size2, struct Kernels *kernels) {
+    void *merged_subsequence = malloc((size_t)(size1 + size2) * kernels->element_size);
 
-    for (int i = 0; i < N; i++) {
-        val[i] = padded_val[i];
-    }
+    kernels->merge(subsequence1, size1, subsequence2, size2, merged_subsequence);
 
-    free(padded_val);
+    return merged_subsequence;
 }
 
 
 /**
- *  \brief Merge two sequences.
+ *  \brief Hash of an integer (splitmix64 finalizer).
  *
- *  Operation carried out by the workers. 
+ *  \param value contains the integer
  *
- *  \param subsequence1 contains the first subsequence1 of integers that needs to be merged
- *  \param size1 contains the size of the subsequence1
- *  \param subsequence2 contains the second subsequence of integers that needs to be merged
- *  \param size2 contains the size of the subsequence2
+ *  \return hash of the integer.
  */
-int * merge_sequences(int *subsequence1, int size1, int *subsequence2, int size2) {
-
-    int *left = subsequence1;
-    int left_size = size1;
-
-    int *right = subsequence2;
-    int right_size = size2;
-
-    int *merged_subsequence = (int*)malloc((left_size + right_size) * sizeof(int));
-
-    int i = 0, j = 0, k = 0;
-
-    while (i < left_size && j < right_size) {
-        if (left[i] <= right[j]) {
-            merged_subsequence[k++] = left[i++];
-        } else {
-            merged_subsequence[k++] = right[j++];
-        }
-    }
+static inline unsigned long long hash(int value) {
+    unsigned long long x = (unsigned int)value + 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
 
-    while (i < left_size) {
-        merged_subsequence[k++] = left[i++];
-    }
+/**
+ *  \brief Add integers to a fingerprint.
+ *
+ *  \param fingerprint contains the fingerprint
+ *  \param values contains the integers
+ *  \param n contains the number of integers
+ */
+void add_to_fingerprint(struct Fingerprint *fingerprint, int *values, long long n) {
+    unsigned long long sum = 0, parity = 0, hash_sum = 0;
 
-    while (j < right_size) {
-        merged_subsequence[k++] = right[j++];
+    for (long long i = 0; i < n; i++) {
+        sum += (unsigned int)values[i];
+        parity ^= (unsigned int)values[i];
+        hash_sum += hash(values[i]);
     }
 
-    return merged_subsequence;
+    fingerprint->sum += sum;
+    fingerprint->parity ^= parity;
+    fingerprint->hash_sum += hash_sum;
 }
 
-
 /**
- *  \brief Validation of final sequence.
+ *  \brief Validate the sort method
  *
- *  Checks whether the final sequence is properly sorted or not.
- * 
- *  \param file contains the struct File that have all the information needed
+ *  Check in the end if the sequence of values is properly sorted and has the same
+ *  fingerprint as the input.
  *
+ *  \param file contains the struct File that have all the information needed
+ *  \param input_fingerprint contains the fingerprint of the integers of the file
  */
-void validate(struct File *file) {
+void validate(struct File *file, struct Fingerprint *input_fingerprint) {
 
-    int *val = file->sequence;
-    int N    = file->size;
+    void *val = file->sequence;
+    int N     = file->size;
 
-    int i;
-    for (i = 0; i < N; i++) {
+    int first_error = file->kernels->first_unsorted(val, 0, N - 1);
 
-        if (i == (N - 1))  {
-            printf ("Everything is OK!\n");
-            break;
-        }
+    // the fingerprint is computed over the 32-bit words of the elements
+    struct Fingerprint output_fingerprint = {0, 0, 0};
+    add_to_fingerprint(&output_fingerprint, (int *)val, (long long)N * (file->kernels->element_size / sizeof(int)));
 
-        if (val[i] > val[i+1]) { 
-            printf ("Error in position %d between element %d and %d\n", i, val[i], val[i+1]);
-            break;
-        }
+    print_validation(file, first_error, (char *)val + (size_t)(first_error >= 0 ? first_error : 0) * file->kernels->element_size,
+                     &output_fingerprint, input_fingerprint);
+}
+
+/**
+ *  \brief Print the validation of the final sequence.
+ *
+ *  \param file contains the struct File that have all the information needed
+ *  \param first_error contains the position of the first element out of order, -1 if there is none
+ *  \param pair contains that element and the next one
+ *  \param output_fingerprint contains the fingerprint of the final sequence
+ *  \param input_fingerprint contains the fingerprint of the integers of the file
+ */
+void print_validation(struct File *file, int first_error, void *pair,
+                      struct Fingerprint *output_fingerprint, struct Fingerprint *input_fingerprint) {
+    if (first_error >= 0) {
+        printf ("Error in position %d between element ", first_error);
+        print_element(file, pair, 0);
+        printf (" and ");
+        print_element(file, pair, 1);
+        printf ("\n");
+    } else if (output_fingerprint->sum != input_fingerprint->sum || output_fingerprint->parity != input_fingerprint->parity ||
+               output_fingerprint->hash_sum != input_fingerprint->hash_sum) {
+        printf ("Error: the sorted sequence does not have the same integers as the file\n");
+    } else {
+        printf ("Everything is OK!\n");
     }
 
     printf ("\n");
-}
\ No newline at end of file
+}
@@ -8,43 +8,152 @@
 
 
 /**
- *  \brief Structure with the filename and file pointer to process.
+ *  \brief Types of the elements of a file.
  *
- *   It also stores the number of integers in the file (size), the
- *   initial unsorted sequence of integers (*sequence), an array of 
- *   pointers to all the subsequences (**subsequences), another array 
- *   of integers to store all the subsequences length (*subsequences_length)
- *   and the size of subsequences (all_subsequences_size).
+ *   A file whose header starts with TYPED_HEADER_MAGIC has the code of the type
+ *   of its elements (32-bit) and the number of elements (64-bit) after it,
+ *   any other file has 32-bit integers and their number in the header.
+ */
+enum ElementType { INT32, UINT32, INT64, UINT64, FLOAT32, FLOAT64 };
+
+/** \brief first 32 bits of a header with the type of the elements ("DSQ" and 0xff, a negative number of integers) */
+#define TYPED_HEADER_MAGIC ((int)0xff515344)
+
+/** \brief number of bytes of the longest header, the one with the type */
+#define MAX_HEADER_SIZE (2 * sizeof(int) + sizeof(long long))
+
+
+/**
+ *  \brief Structure with the kernels of a type of element.
+ *
+ *   The floating-point numbers are sorted as unsigned integers of the same size,
+ *   after a transform which keeps their total order, so they use those kernels.
+ */
+struct Kernels {
+  size_t element_size;
+  void (*sort)(void *val, int N);
+  void (*merge)(void *left, int left_size, void *right, int right_size, void *merged);
+  void (*merge_split)(void *own, int own_size, void *other, int other_size, void *kept, int kept_size, bool lower);
+  int (*first_unsorted)(void *val, int start, int last);
+  int (*sort_runs)(void *val, int N, void *buffer);
+};
+
+
+/**
+ *  \brief Order-independent fingerprint of a multiset of integers.
+ *
+ *   Sum, bitwise parity (xor) and sum of a hash of the integers, all modulo 2^64: a
+ *   sorted sequence must have the same fingerprint as the input, so integers lost or
+ *   duplicated by the sort are detected. The fingerprints of parts of a sequence are
+ *   combined by adding the sums and xoring the parities.
+ */
+struct Fingerprint {
+  unsigned long long sum;
+  unsigned long long parity;
+  unsigned long long hash_sum;
+};
+
+
+/**
+ *  \brief Structure with the filename to process.
+ *
+ *   It also stores the number of elements in the file (size), their type,
+ *   whether the header of the file has it (typed_header) and its number of
+ *   bytes (header_size), the kernels that sort the elements, the sorted
+ *   sequence of elements (*sequence), an array of integers to store all the
+ *   subsequences length (*subsequences_length) and another one with their
+ *   offsets in the sequence (*subsequences_offset): the part of the file
+ *   each process reads.
  * 
  */
 struct File {
   char *filename;
-  FILE *file;
   int size;
-  int *sequence;
-  int **subsequences;
+  enum ElementType type;
+  bool typed_header;
+  int header_size;
+  struct Kernels *kernels;
+  void *sequence;
   int *subsequences_length;
-  int all_subsequences_size;
+  int *subsequences_offset;
 };
 
 
 /**
- *  \brief Read the file.
+ *  \brief Kernels of a type of element.
+ *
+ *  \param type contains the type of the elements
+ *
+ *  \return kernels that sort the elements (or their keys, for floating-point numbers).
+ */
+extern struct Kernels *kernels_of(enum ElementType type);
+
+/**
+ *  \brief Transform floating-point numbers into keys with the same total order.
+ *
+ *  \param type contains the type of the elements
+ *  \param values contains the elements
+ *  \param n contains the number of elements
+ */
+extern void to_keys(enum ElementType type, void *values, int n);
+
+/**
+ *  \brief Transform keys back into the floating-point numbers they came from.
+ *
+ *  \param type contains the type of the elements
+ *  \param values contains the keys
+ *  \param n contains the number of keys
+ */
+extern void from_keys(enum ElementType type, void *values, int n);
+
+/**
+ *  \brief Read the header of the file.
+ *
+ *  Reads the type and the number of elements of the file from its first bytes and
+ *  checks them against the size of the file.
  *
- *  Reads a binary file and stores its content in an array of integers.
+ *  \param file contains the struct File that have all the information needed
+ *  \param bytes contains the first bytes of the file
+ *  \param n_bytes contains the number of bytes read, at most MAX_HEADER_SIZE
+ *  \param file_size contains the number of bytes of the file
+ *  \param report contains true to print why the header is not valid
+ *
+ *  \return true if the header is valid, false otherwise.
+ */
+extern bool read_header(struct File *file, char *bytes, int n_bytes, long long file_size, bool report);
+
+/**
+ *  \brief Add integers to a fingerprint.
  *
+ *  \param fingerprint contains the fingerprint
+ *  \param values contains the integers
+ *  \param n contains the number of integers
  */
-extern void read_file(struct File *file);
+extern void add_to_fingerprint(struct Fingerprint *fingerprint, int *values, long long n);
 
 /**
  *  \brief Validation of final sequence.
  *
- *  Checks whether the final sequence is properly sorted or not.
+ *  Checks whether the final sequence is properly sorted and has the same fingerprint
+ *  as the input.
  * 
  *  \param file contains the struct File that have all the information needed
+ *  \param input_fingerprint contains the fingerprint of the integers of the file
+ *
+ */
+extern void validate(struct File *file, struct Fingerprint *input_fingerprint);
+
+/**
+ *  \brief Print the validation of the final sequence.
  *
+ *  \param file contains the struct File that have all the information needed
+ *  \param first_error contains the position of the first element out of order, -1 if there is none
+ *  \param pair contains that element and the next one
+ *  \param output_fingerprint contains the fingerprint of the final sequence
+ *  \param input_fingerprint contains the fingerprint of the integers of the file
  */
-extern void validate(struct File *file);
+extern void print_validation(struct File *file, int first_error, void *pair,
+                             struct Fingerprint *output_fingerprint, struct Fingerprint *input_fingerprint);
 
 
 /**
@@ -52,42 +161,46 @@ extern void validate(struct File *file);
  *
  *  Operation carried out by the workers.
  *
- *  \param subsequence contains the subsequence of integers that needs to be sorted
+ *  \param subsequence contains the subsequence of elements that needs to be sorted
  *  \param size contains the size of the subsequence
+ *  \param kernels contains the kernels of the type of the elements
+ *  \param natural_runs contains true to merge the natural runs of the subsequence, false for the bitonic sort
  */
-extern int * sort_sequence(int *subsequence, int size);
+extern void * sort_sequence(void *subsequence, int size, struct Kernels *kernels, bool natural_runs);
 
 /**
  *  \brief Merge two sequences.
  *
  *  Operation carried out by the workers. 
  *
- *  \param subsequence1 contains the first subsequence1 of integers that needs to be merged
+ *  \param subsequence1 contains the first subsequence1 of elements that needs to be merged
  *  \param size1 contains the size of the subsequence1
- *  \param subsequence2 contains the second subsequence of integers that needs to be merged
+ *  \param subsequence2 contains the second subsequence of elements that needs to be merged
  *  \param size2 contains the size of the subsequence2
+ *  \param kernels contains the kernels of the type of the elements
  */
-extern int * merge_sequences(int *subsequence1, int size1, int *subsequence2, int size2);
+extern void * merge_sequences(void *subsequence1, int size1, void *subsequence2, int size2, struct Kernels *kernels);
 
 
 /**
  *  \brief Divide the work between the workers.
  *
- *  Operation carried out by the dispatcher.
+ *  Operation carried out by every process. The sizes of the subsequences differ by
+ *  one at most, the first ones are the greatest.
  * 
  *  \param file contains the struct File that have all the information needed
  *  \param n contains the number of parts that the sequence needs to be divided
  */
 extern void divide_work(struct File *file, int n);
 
-/**
- *  \brief Applies the Bitonic Sort algorithm to a subsequence of integers.
- *
- *  Operation carried out by the workers.
- *
- *  \param val contains the subsequence of integers to be sorted
- *  \param N contains the size of the subsequence
- */
-extern void bitonicSort(int *val, int N);
+/* kernels of each type of element (see sortKernels.h) */
+extern void bitonicSort_int(int *val, int N);
+extern void bitonicSort_u32(unsigned int *val, int N);
+extern void bitonicSort_i64(long long *val, int N);
+extern void bitonicSort_u64(unsigned long long *val, int N);
+extern int powerSort_int(int *val, int N, int *buffer);
+extern int powerSort_u32(unsigned int *val, int N, unsigned int *buffer);
+extern int powerSort_i64(long long *val, int N, long long *buffer);
+extern int powerSort_u64(unsigned long long *val, int N, unsigned long long *buffer);
 
 #endif /* MONITOR_H */
\ No newline at end of file
@@ -0,0 +1,360 @@
+/**
+ *  \file sortKernels.h (template file)
+ *
+ *  \brief Sort, merge and validation kernels for one type of element.
+ *
+ *  This file is included once per type of element, with ELEMENT defined as the type and
+ *  KERNEL(name) as the name of the kernels for that type, e.g. for the integers
+ *
+ *      #define ELEMENT int
+ *      #define KERNEL(name) name##_int
+ *      #include "sortKernels.h"
+ *
+ *  defines bitonicSort_int, powerSort_int, merge_int, merge_split_int and first_unsorted_int,
+ *  and the table kernels_int with them, to be called through the type of the elements of the file.
+ *  That is why it has no include guard.
+ *
+ *  \author Artur Romão e João Reis - April 2023
+ */
+
+
+static void KERNEL(compareAndPossibleSwap)(ELEMENT *val, int i, int j, int dir) {
+    if ((val[i] > val[j]) == dir) {
+        ELEMENT temp = val[i];
+        val[i] = val[j];
+        val[j] = temp;
+    }
+}
+
+static void KERNEL(bitonicMerge)(ELEMENT *val, int low, int cnt, int dir) {
+    if (cnt > 1) {
+        // greatest power of two smaller than cnt, so any size can be sorted without padding
+        int k = 1;
+        while (2 * k < cnt) k *= 2;
+
+        for (int i = low; i < low + cnt - k; i++) {
+            KERNEL(compareAndPossibleSwap)(val, i, i + k, dir);
+        }
+        KERNEL(bitonicMerge)(val, low, k, dir);
+        KERNEL(bitonicMerge)(val, low + k, cnt - k, dir);
+    }
+}
+
+static void KERNEL(bitonicSortRecursive)(ELEMENT *val, int low, int cnt, int dir) {
+    if (cnt > 1) {
+        int k = cnt / 2;
+        KERNEL(bitonicSortRecursive)(val, low, k, !dir);
+        KERNEL(bitonicSortRecursive)(val, low + k, cnt - k, dir);
+        KERNEL(bitonicMerge)(val, low, cnt, dir);
+    }
+}
+
+/**
+ *  \brief Applies the Bitonic Sort algorithm to a subsequence.
+ *
+ *  \param val contains the subsequence to be sorted
+ *  \param N contains the size of the subsequence
+ */
+void KERNEL(bitonicSort)(ELEMENT *val, int N) {
+    KERNEL(bitonicSortRecursive)(val, 0, N, 1);
+}
+
+/**
+ *  \brief Merge two sorted subsequences.
+ *
+ *  \param left contains the first sorted subsequence
+ *  \param left_size contains the size of the first subsequence
+ *  \param right contains the second sorted subsequence
+ *  \param right_size contains the size of the second subsequence
+ *  \param merged contains the merged subsequence, with room for both
+ */
+void KERNEL(merge)(ELEMENT *left, int left_size, ELEMENT *right, int right_size, ELEMENT *merged) {
+    int i = 0, j = 0, k = 0;
+
+    while (i < left_size && j < right_size) {
+        if (left[i] <= right[j]) {
+            merged[k++] = left[i++];
+        } else {
+            merged[k++] = right[j++];
+        }
+    }
+
+    while (i < left_size) {
+        merged[k++] = left[i++];
+    }
+
+    while (j < right_size) {
+        merged[k++] = right[j++];
+    }
+}
+
+/**
+ *  \brief Compare-split of two sorted blocks.
+ *
+ *  Merges the two blocks only as far as needed to keep the kept_size smallest elements
+ *  (lower) or the kept_size greatest ones, in order.
+ *
+ *  \param own contains the first sorted block
+ *  \param own_size contains the size of the first block
+ *  \param other contains the second sorted block
+ *  \param other_size contains the size of the second block
+ *  \param kept contains the elements kept
+ *  \param kept_size contains the number of elements kept, at most own_size + other_size
+ *  \param lower contains true to keep the smallest elements, false to keep the greatest ones
+ */
+void KERNEL(merge_split)(ELEMENT *own, int own_size, ELEMENT *other, int other_size, ELEMENT *kept, int kept_size, bool lower) {
+    if (lower) {
+        int i = 0, j = 0;
+        for (int k = 0; k < kept_size; k++) {
+            if (j >= other_size || (i < own_size && own[i] <= other[j])) {
+                kept[k] = own[i++];
+            } else {
+                kept[k] = other[j++];
+            }
+        }
+    } else {
+        int i = own_size - 1, j = other_size - 1;
+        for (int k = kept_size - 1; k >= 0; k--) {
+            if (j < 0 || (i >= 0 && own[i] > other[j])) {
+                kept[k] = own[i--];
+            } else {
+                kept[k] = other[j--];
+            }
+        }
+    }
+}
+
+/**
+ *  \brief First element out of order.
+ *
+ *  \param val contains the sequence
+ *  \param start contains the first position to check
+ *  \param last contains the last position to check, which is compared with the one before
+ *
+ *  \return first position i, from start, with val[i] > val[i + 1], -1 if there is none.
+ */
+int KERNEL(first_unsorted)(ELEMENT *val, int start, int last) {
+    for (int i = start; i < last; i++) {
+        if (val[i] > val[i+1]) return i;
+    }
+    return -1;
+}
+
+/**
+ *  \brief Length of the natural run that starts at a position, which is left ascending.
+ *
+ *  A run is either ascending (no element smaller than the one before it) or strictly
+ *  descending, so reversing it does not change the order of equal elements.
+ *
+ *  \param val contains the sequence
+ *  \param low contains the first position of the run
+ *  \param N contains the size of the sequence
+ *
+ *  \return size of the run.
+ */
+static int KERNEL(natural_run)(ELEMENT *val, int low, int N) {
+    int high = low + 1;
+    if (high >= N) return N - low;
+
+    if (val[high] < val[low]) {
+        while (high + 1 < N && val[high + 1] < val[high]) high++;
+
+        for (int i = low, j = high; i < j; i++, j--) {
+            ELEMENT temp = val[i];
+            val[i] = val[j];
+            val[j] = temp;
+        }
+    } else {
+        while (high + 1 < N && val[high + 1] >= val[high]) high++;
+    }
+
+    return high + 1 - low;
+}
+
+/**
+ *  \brief Insert the elements of a range, one by one, after the sorted ones before it.
+ *
+ *  \param val contains the sequence
+ *  \param low contains the first position of the sorted elements
+ *  \param sorted contains the first position of the elements to insert
+ *  \param high contains the position after the last element to insert
+ */
+static void KERNEL(insertion_sort)(ELEMENT *val, int low, int sorted, int high) {
+    for (int i = sorted; i < high; i++) {
+        ELEMENT element = val[i];
+        int j = i;
+
+        while (j > low && val[j - 1] > element) {
+            val[j] = val[j - 1];
+            j--;
+        }
+        val[j] = element;
+    }
+}
+
+/**
+ *  \brief Merge two adjacent sorted runs in place.
+ *
+ *  The elements of the left run not greater than the first one of the right run, and
+ *  those of the right run not smaller than the last one of the left run, are already
+ *  in place, so only the elements between them are merged: runs already in order cost
+ *  two binary searches. The rest of the left run is moved to the buffer first.
+ *
+ *  \param val contains the sequence
+ *  \param low contains the first position of the left run
+ *  \param mid contains the first position of the right run
+ *  \param high contains the position after the right run
+ *  \param buffer contains room for the left run
+ */
+static void KERNEL(merge_runs)(ELEMENT *val, int low, int mid, int high, ELEMENT *buffer) {
+    int first = low, last = mid;
+
+    while (first < last) {
+        int i = first + (last - first) / 2;
+        if (val[i] <= val[mid]) first = i + 1; else last = i;
+    }
+    low = first;
+    if (low == mid) return;
+
+    first = mid;
+    last = high;
+    while (first < last) {
+        int i = first + (last - first) / 2;
+        if (val[i] < val[mid - 1]) first = i + 1; else last = i;
+    }
+    high = first;
+
+    int left_size = mid - low;
+    int i = 0, j = mid, k = low;
+
+    memcpy(buffer, val + low, left_size * sizeof(ELEMENT));
+
+    while (i < left_size && j < high) {
+        if (buffer[i] <= val[j]) {
+            val[k++] = buffer[i++];
+        } else {
+            val[k++] = val[j++];
+        }
+    }
+
+    while (i < left_size) {
+        val[k++] = buffer[i++];
+    }
+}
+
+/**
+ *  \brief Power of the boundary between two adjacent runs (powersort).
+ *
+ *  It is the depth, in a perfectly balanced merge tree of the sequence, of the node
+ *  that splits the middle points of the two runs: the first bit in which their
+ *  positions, as fractions of the size of the sequence, differ.
+ *
+ *  \param start contains the first position of the left run
+ *  \param left_size contains the size of the left run
+ *  \param right_size contains the size of the right run
+ *  \param N contains the size of the sequence
+ *
+ *  \return power of the boundary.
+ */
+static int KERNEL(node_power)(long long start, long long left_size, long long right_size, long long N) {
+    long long a = 2 * start + left_size;      // twice the middle point of the left run
+    long long b = a + left_size + right_size; // twice the middle point of the right run
+    int power = 0;
+
+    while (true) {
+        power++;
+        if (a >= N) {
+            a -= N;
+            b -= N;
+        } else if (b >= N) {
+            break;
+        }
+        a <<= 1;
+        b <<= 1;
+    }
+
+    return power;
+}
+
+/**
+ *  \brief Sorts a subsequence by merging its natural runs (powersort).
+ *
+ *  The subsequence is split into its ascending and descending runs, the descending ones
+ *  reversed and those shorter than MIN_RUN extended by insertion sort. The runs are
+ *  merged as they are found, in the order given by the powers of their boundaries, which
+ *  keeps the merges balanced, so a sorted or reversed subsequence takes one pass and a
+ *  few runs take about one pass each.
+ *
+ *  \param val contains the subsequence to be sorted
+ *  \param N contains the size of the subsequence
+ *  \param buffer contains room for N elements
+ *
+ *  \return number of natural runs found.
+ */
+int KERNEL(powerSort)(ELEMENT *val, int N, ELEMENT *buffer) {
+    int start[64], size[64], power[64];   // runs waiting to be merged, with increasing powers
+    int top = 0;
+    int n_runs = 0;
+
+    for (int low = 0; low < N; ) {
+        int run = KERNEL(natural_run)(val, low, N);
+        n_runs++;
+
+        if (run < MIN_RUN) {
+            int end = (N - low < MIN_RUN) ? N : low + MIN_RUN;
+            KERNEL(insertion_sort)(val, low, low + run, end);
+            run = end - low;
+        }
+
+        if (top > 0) {
+            int node = KERNEL(node_power)(start[top - 1], size[top - 1], run, N);
+
+            // the runs below a deeper boundary are merged first
+            while (top > 1 && power[top - 1] > node) {
+                KERNEL(merge_runs)(val, start[top - 2], start[top - 1], start[top - 1] + size[top - 1], buffer);
+                size[top - 2] += size[top - 1];
+                top--;
+            }
+            power[top] = node;
+        }
+
+        start[top] = low;
+        size[top] = run;
+        top++;
+        low += run;
+    }
+
+    while (top > 1) {
+        KERNEL(merge_runs)(val, start[top - 2], start[top - 1], start[top - 1] + size[top - 1], buffer);
+        size[top - 2] += size[top - 1];
+        top--;
+    }
+
+    return n_runs;
+}
+
+static void KERNEL(sort_elements)(void *val, int N) {
+    KERNEL(bitonicSort)((ELEMENT *)val, N);
+}
+
+static void KERNEL(merge_elements)(void *left, int left_size, void *right, int right_size, void *merged) {
+    KERNEL(merge)((ELEMENT *)left, left_size, (ELEMENT *)right, right_size, (ELEMENT *)merged);
+}
+
+static void KERNEL(merge_split_elements)(void *own, int own_size, void *other, int other_size, void *kept, int kept_size, bool lower) {
+    KERNEL(merge_split)((ELEMENT *)own, own_size, (ELEMENT *)other, other_size, (ELEMENT *)kept, kept_size, lower);
+}
+
+static int KERNEL(first_unsorted_elements)(void *val, int start, int last) {
+    return KERNEL(first_unsorted)((ELEMENT *)val, start, last);
+}
+
+static int KERNEL(sort_runs_elements)(void *val, int N, void *buffer) {
+    return KERNEL(powerSort)((ELEMENT *)val, N, (ELEMENT *)buffer);
+}
+
+/** \brief kernels of the type */
+static struct Kernels KERNEL(kernels) = {
+    sizeof(ELEMENT), KERNEL(sort_elements), KERNEL(merge_elements), KERNEL(merge_split_elements),
+    KERNEL(first_unsorted_elements), KERNEL(sort_runs_elements)
+};
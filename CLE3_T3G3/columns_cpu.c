@@ -0,0 +1,496 @@
+/**
+ *   Artur Romão e João Reis, May 2023
+ *
+ *   CPU version of columns.cu: the subsequences sorted and merged are the columns of the
+ *   N x N matrix, and the sorted sequence is stored by columns (column 0 holds its first
+ *   N elements, and so on). Sorting the columns where they are would read the matrix with
+ *   a stride of N integers, a cache miss for each element, so the matrix is transposed in
+ *   tiles that fit in the cache, the columns, now rows, are sorted and merged contiguously
+ *   as in rows_cpu.c, and the result is transposed back. The time of each phase is printed,
+ *   to compare with rows_cpu.c.
+ *
+ *   ./columns_cpu datSeq1M.bin -N 1024 -t 8 -o sorted.bin
+ */
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+
+/**
+ *   program configuration
+ */
+
+# define DEFAULT_N 1024
+
+# define DEFAULT_THREADS 4
+
+# define ROWS_PER_BLOCK 64                               // rows read from the file at a time
+
+# define TILE 32                                         // rows and columns of a tile of the transpose, 4 KiB
+
+
+/**
+ *   order-independent fingerprint of the integers (sum, xor and sum of a hash, modulo 2^64),
+ *   the sorted matrix must have the same one as the file
+ */
+
+struct Fingerprint {
+    unsigned long long sum;
+    unsigned long long parity;
+    unsigned long long hash_sum;
+};
+
+
+/**
+ *   matrix shared by the threads: the two buffers the elements move between
+ */
+
+static int N;
+
+static int n_threads;
+
+static int *buffers[2];
+
+static pthread_barrier_t iteration_done;
+
+static int result;                                       // buffer with the sorted matrix
+
+static double phase_time[3];                             // transpose, sort and merge, transpose back
+
+
+/* allusion to internal functions */
+
+static double get_delta_time(void);
+
+static void print_usage(char *cmd_name);
+
+void add_to_fingerprint(struct Fingerprint *fingerprint, int *values, int n);
+
+void validate(int *matrix, struct Fingerprint *input_fingerprint);
+
+void transpose(int *in, int *out, int first_row, int last_row);
+
+void write_file(const char *filename, int *matrix);
+
+void sort_row(int *row, int *temp, int size);
+
+int co_rank(int k, int *left, int left_size, int *right, int right_size);
+
+void merge_range(int *left, int *right, int size, int *merged, int k, int k_end);
+
+static void *sort_matrix(void *arg);
+
+
+int main (int argc, char **argv)  {
+
+    if (argc < 2) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // process command line arguments
+    const char *filename = argv[1];
+    const char *output_filename = NULL;
+    N = DEFAULT_N;
+    n_threads = DEFAULT_THREADS;
+    int opt;
+
+    optind = 2;
+    while ((opt = getopt(argc, argv, "hN:t:o:")) != -1) {
+        switch (opt) {
+            case 'N': // number of rows and columns
+                N = atoi(optarg);
+                if (N < 1 || (N & (N - 1)) != 0 || N > (1 << 15)) {
+                    fprintf(stderr, "%s: N must be a power of two between 1 and 32768\n", argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 't': // number of threads
+                n_threads = atoi(optarg);
+                if (n_threads < 1) {
+                    fprintf(stderr, "%s: number of threads must be greater or equal than 1\n", argv[0]);
+                    return EXIT_FAILURE;
+                }
+                break;
+
+            case 'o': // output file
+                output_filename = optarg;
+                break;
+
+            case 'h': // help mode
+                print_usage(argv[0]);
+                return EXIT_SUCCESS;
+
+            default: // invalid option
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    printf("%s Starting with %d threads...\n", argv[0], n_threads);
+
+    // start counting the execution time
+    (void) get_delta_time ();
+
+    int size = N * N;
+    buffers[0] = (int *) malloc(sizeof(int) * size);
+    buffers[1] = (int *) malloc(sizeof(int) * size);
+
+    if (buffers[0] == NULL || buffers[1] == NULL) {
+        printf("Error: could not allocate the matrix\n");
+        return EXIT_FAILURE;
+    }
+
+    // read the file
+    FILE *fp = fopen(filename, "rb");
+
+    if (fp == NULL) {
+      printf("Error: could not open file %s\n", filename);
+      return EXIT_FAILURE;
+    }
+
+    // Read the header of the binary file
+    int file_size;
+    if (fread(&file_size, sizeof(int), 1, fp) != 1) {
+        printf("Error reading the file %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    // the header must match the size of the file and the size of the matrix
+    struct stat st;
+    if (fstat(fileno(fp), &st) != 0 || file_size != size ||
+        (long long)st.st_size != (long long)sizeof(int) * (1 + (long long)file_size)) {
+        printf("Error: the file %s must have %d integers\n", filename, size);
+        exit(EXIT_FAILURE);
+    }
+
+    // Read the contents of the file in blocks of rows
+    struct Fingerprint input_fingerprint = {0, 0, 0};
+
+    for (int row = 0; row < N; row += ROWS_PER_BLOCK) {
+        int rows = (N - row < ROWS_PER_BLOCK) ? N - row : ROWS_PER_BLOCK;
+
+        if (fread(buffers[0] + row * N, sizeof(int), rows * N, fp) != (size_t) (rows * N)) {
+            printf("Error reading the file %s\n", filename);
+            exit(EXIT_FAILURE);
+        }
+        add_to_fingerprint(&input_fingerprint, buffers[0] + row * N, rows * N);
+    }
+
+    fclose(fp);
+
+    printf("file read in %.6fs\n", get_delta_time());
+
+    // sort the matrix with the threads
+    pthread_t *threads = (pthread_t *) malloc(n_threads * sizeof(pthread_t));
+    int *thread_ids = (int *) malloc(n_threads * sizeof(int));
+
+    pthread_barrier_init(&iteration_done, NULL, n_threads);
+
+    for (int i = 0; i < n_threads; i++) {
+        thread_ids[i] = i;
+        if (pthread_create(&threads[i], NULL, sort_matrix, &thread_ids[i]) != 0) {
+            perror("[error] on creating thread");
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (int i = 0; i < n_threads; i++) {
+        if (pthread_join(threads[i], NULL) != 0) {
+            perror("[error] on waiting for thread");
+            return EXIT_FAILURE;
+        }
+    }
+
+    pthread_barrier_destroy(&iteration_done);
+
+    int *sorted_matrix = buffers[result];
+
+    validate(sorted_matrix, &input_fingerprint);
+
+    printf("transpose = %.6fs, sort and merge = %.6fs, transpose back = %.6fs\n", phase_time[0], phase_time[1], phase_time[2]);
+    printf("CPU execution time = %.6fs\n", phase_time[0] + phase_time[1] + phase_time[2]);
+
+    // write the sorted sequence, if an output file is given: the matrix read by columns
+    if (output_filename != NULL) {
+        transpose(sorted_matrix, buffers[1 - result], 0, N);
+        write_file(output_filename, buffers[1 - result]);
+    }
+
+    free(buffers[0]);
+    free(buffers[1]);
+    free(threads);
+    free(thread_ids);
+
+    return 0;
+}
+
+
+/**
+ *   life cycle of a thread: transpose its rows, sort its rows (the columns), then its part of
+ *   each merge iteration and transpose its rows back; thread 0 times the phases
+ */
+
+static void *sort_matrix(void *arg) {
+    int id = *((int *) arg);
+    int size = N * N;
+
+    int first_row = (int) ((long long) N * id / n_threads);
+    int last_row = (int) ((long long) N * (id + 1) / n_threads);
+
+    // the columns become the rows of the other buffer
+    transpose(buffers[0], buffers[1], first_row, last_row);
+
+    pthread_barrier_wait(&iteration_done);
+    if (id == 0) phase_time[0] = get_delta_time();
+
+    // iteration 0: the rows of the thread, sorted in place with the other buffer as scratch
+    for (int row = first_row; row < last_row; row++) {
+        sort_row(buffers[1] + row * N, buffers[0] + row * N, N);
+    }
+
+    pthread_barrier_wait(&iteration_done);
+
+    // merge iterations: the thread writes the same share of the merged matrix in each of them
+    int k_first = (int) ((long long) size * id / n_threads);
+    int k_last = (int) ((long long) size * (id + 1) / n_threads);
+
+    int source = 1;
+    for (int subsequence_size = N; subsequence_size < size; subsequence_size *= 2) {
+        int *in = buffers[source];
+        int *out = buffers[1 - source];
+        int merge_size = 2 * subsequence_size;
+
+        // the merges the share of the thread overlaps, and the part of each one in the share
+        for (int start = k_first - k_first % merge_size; start < k_last; start += merge_size) {
+            int k = (k_first > start) ? k_first - start : 0;
+            int k_end = (k_last < start + merge_size) ? k_last - start : merge_size;
+
+            merge_range(in + start, in + start + subsequence_size, subsequence_size, out + start, k, k_end);
+        }
+
+        source = 1 - source;
+        pthread_barrier_wait(&iteration_done);
+    }
+
+    if (id == 0) phase_time[1] = get_delta_time();
+
+    // the sorted rows go back to the columns
+    transpose(buffers[source], buffers[1 - source], first_row, last_row);
+
+    pthread_barrier_wait(&iteration_done);
+    if (id == 0) {
+        phase_time[2] = get_delta_time();
+        result = 1 - source;
+    }
+
+    return NULL;
+}
+
+
+/**
+ *   transposes the rows first_row to last_row (excluded) of in into the columns of out, in
+ *   tiles of TILE x TILE integers: the rows of a tile are read and its columns written while
+ *   all of them are in the cache
+ */
+
+void transpose(int *in, int *out, int first_row, int last_row) {
+    for (int tile_row = first_row; tile_row < last_row; tile_row += TILE) {
+        int tile_row_end = (tile_row + TILE < last_row) ? tile_row + TILE : last_row;
+
+        for (int tile_column = 0; tile_column < N; tile_column += TILE) {
+            int tile_column_end = (tile_column + TILE < N) ? tile_column + TILE : N;
+
+            for (int row = tile_row; row < tile_row_end; row++) {
+                for (int column = tile_column; column < tile_column_end; column++) {
+                    out[column * N + row] = in[row * N + column];
+                }
+            }
+        }
+    }
+}
+
+
+static double get_delta_time(void)
+{
+  static struct timespec t0,t1;
+
+  t0 = t1;
+  if(clock_gettime(CLOCK_MONOTONIC,&t1) != 0)
+  {
+    perror("clock_gettime");
+    exit(1);
+  }
+  return (double)(t1.tv_sec - t0.tv_sec) + 1.0e-9 * (double)(t1.tv_nsec - t0.tv_nsec);
+}
+
+
+static void print_usage(char *cmd_name) {
+    fprintf(stderr, "\nSynopsis: %s filename [OPTIONS]\n"
+            "  OPTIONS:\n"
+            "  -N size        --- number of rows and columns of the matrix, a power of two (default: %d)\n"
+            "  -t nThreads    --- set the number of threads (default: %d)\n"
+            "  -o filename    --- write the sorted sequence to filename\n"
+            "  -h             --- print this help\n", cmd_name, DEFAULT_N, DEFAULT_THREADS);
+}
+
+
+static inline unsigned long long hash(int value) {
+    unsigned long long x = (unsigned int)value + 0x9e3779b97f4a7c15ULL;   // splitmix64 finalizer
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+
+void add_to_fingerprint(struct Fingerprint *fingerprint, int *values, int n) {
+    for (int i = 0; i < n; i++) {
+        fingerprint->sum += (unsigned int)values[i];
+        fingerprint->parity ^= (unsigned int)values[i];
+        fingerprint->hash_sum += hash(values[i]);
+    }
+}
+
+
+/**
+ *   validates the matrix read by columns: element i of the sequence is in row i % N of column i / N
+ */
+
+void validate(int *matrix, struct Fingerprint *input_fingerprint) {
+
+    int size = N * N;
+    int i;
+    for (i = 0; i < size - 1; i++) {
+        int current = matrix[(i % N) * N + i / N];
+        int next = matrix[((i + 1) % N) * N + (i + 1) / N];
+
+        if (current > next) {
+            printf ("Error in position %d between element %d and %d\n", i, current, next);
+            break;
+        }
+    }
+
+    if (i >= size - 1) {
+        struct Fingerprint output_fingerprint = {0, 0, 0};
+        add_to_fingerprint(&output_fingerprint, matrix, size);
+
+        if (output_fingerprint.sum != input_fingerprint->sum || output_fingerprint.parity != input_fingerprint->parity ||
+            output_fingerprint.hash_sum != input_fingerprint->hash_sum) {
+            printf ("Error: the sorted matrix does not have the same integers as the file\n");
+        } else {
+            printf ("Everything is OK!\n");
+        }
+    }
+
+    printf ("\n");
+}
+
+
+/**
+ *   writes the sorted matrix in the format of the input files: the number of integers and the integers
+ */
+
+void write_file(const char *filename, int *matrix) {
+    FILE *fp = fopen(filename, "wb");
+
+    if (fp == NULL) {
+        printf("Error: could not open file %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    int size = N * N;
+    bool written = fwrite(&size, sizeof(int), 1, fp) == 1 && fwrite(matrix, sizeof(int), size, fp) == (size_t) size;
+
+    if (fclose(fp) != 0 || !written) {
+        printf("Error writing the file %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("sorted sequence written to %s\n", filename);
+}
+
+
+/**
+ *   sorts a row with a bottom-up merge sort (O(N log N)), the elements move between the row
+ *   and temp, which has the same size, and the sorted row ends in row
+ */
+
+void sort_row(int *row, int *temp, int size) {
+    int *in = row, *out = temp;
+
+    for (int width = 1; width < size; width *= 2) {
+        for (int start = 0; start < size; start += 2 * width) {
+            int middle = (start + width < size) ? start + width : size;
+            int end = (start + 2 * width < size) ? start + 2 * width : size;
+
+            int i = start, j = middle, k = start;
+            while (i < middle && j < end) {
+                out[k++] = (in[i] <= in[j]) ? in[i++] : in[j++];
+            }
+            while (i < middle) out[k++] = in[i++];
+            while (j < end) out[k++] = in[j++];
+        }
+
+        int *swap = in;
+        in = out;
+        out = swap;
+    }
+
+    if (in != row) {
+        memcpy(row, in, size * sizeof(int));
+    }
+}
+
+
+/**
+ *   merge path: number of elements of left among the first k elements of the merge of left
+ *   and right (binary search, ties are taken from left)
+ */
+
+int co_rank(int k, int *left, int left_size, int *right, int right_size) {
+    int low  = (k > right_size) ? k - right_size : 0;
+    int high = (k < left_size) ? k : left_size;
+
+    while (low < high) {
+        int i = low + (high - low) / 2;
+
+        if (left[i] <= right[k - i - 1]) {
+            low = i + 1;
+        } else {
+            high = i;
+        }
+    }
+
+    return low;
+}
+
+
+/**
+ *   merges the positions k to k_end (excluded) of the merge of two sorted subsequences of
+ *   the same size into merged
+ */
+
+void merge_range(int *left, int *right, int size, int *merged, int k, int k_end) {
+    int i = co_rank(k, left, size, right, size);
+    int j = k - i;
+    int i_end = co_rank(k_end, left, size, right, size);
+    int j_end = k_end - i_end;
+
+    while (i < i_end && j < j_end) {
+        if (left[i] <= right[j]) {
+            merged[k++] = left[i++];
+        } else {
+            merged[k++] = right[j++];
+        }
+    }
+
+    while (i < i_end) merged[k++] = left[i++];
+    while (j < j_end) merged[k++] = right[j++];
+}
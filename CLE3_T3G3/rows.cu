@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include "common.h"
 #include <cuda_runtime.h>
@@ -16,6 +17,20 @@
 
 # define N 1024
 
+# define ROWS_PER_BLOCK 64                               // rows read from the file at a time
+
+
+/**
+ *   order-independent fingerprint of the integers (sum, xor and sum of a hash, modulo 2^64),
+ *   the sorted matrix must have the same one as the file
+ */
+
+struct Fingerprint {
+    unsigned long long sum;
+    unsigned long long parity;
+    unsigned long long hash_sum;
+};
+
 
 /* allusion to internal functions */
 
@@ -27,7 +42,11 @@ __global__ void sortSubsequence(int* matrix_gpu, int iter);
 
 __device__ void swap(int* arr, int i, int j);
 
-void validate(int *matrix);
+void add_to_fingerprint(struct Fingerprint *fingerprint, int *values, int n);
+
+void validate(int *matrix, struct Fingerprint *input_fingerprint);
+
+void write_file(const char *filename, int *matrix);
 
 void print_array(int arr[], int size, int file_size);
 
@@ -61,8 +80,9 @@ int main (int argc, char **argv)  {
 
     // create memory areas in host and device memory where the disk sectors data and sector numbers will be stored
     
-    // host allocation memory
-    int *matrix = (int *)malloc(N * N * sizeof(int));
+    // host allocation memory (pinned, so the copies to the device are asynchronous)
+    int *matrix;
+    CHECK (cudaMallocHost((void **) &matrix, N * N * sizeof(int)));
     
     // device allocation memory
     int *device_matrix;
@@ -92,20 +112,47 @@ int main (int argc, char **argv)  {
 
     printf("file_size =  %d\n", file_size);
 
-    // Read the contents of the file
-    int num;
-    int i = 0;
-    while(fread(&num, sizeof(int), 1, fp) == 1) {
-        matrix[i] = num;
-        i++;
+    // the header must match the size of the file and the size of the matrix
+    struct stat st;
+    if (fstat(fileno(fp), &st) != 0 || file_size != N * N ||
+        (long long)st.st_size != (long long)sizeof(int) * (1 + (long long)file_size)) {
+        printf("Error: the file %s must have %d integers\n", filename, N * N);
+        exit(EXIT_FAILURE);
     }
 
-    fclose(fp);
+    // Read the contents of the file in blocks of rows: each block is copied to the device
+    // and its rows are sorted (iteration 0) while the next block is read
+    cudaStream_t stream;
+    CHECK (cudaStreamCreate (&stream));
 
-    // copy the host data to the device memory
+    struct Fingerprint input_fingerprint = {0, 0, 0};
+
+    // the GPU time starts here, as the copy to the device: the file is read in the same loop, overlapped
+    // with the copies and the sort of the rows, so the first part of the time includes the reading too
     (void) get_delta_time ();
-    CHECK (cudaMemcpy (device_matrix, matrix, N * N * sizeof(int), cudaMemcpyHostToDevice));
-    printf ("copy the host data to the device memory\n");
+
+    for (int row = 0; row < N; row += ROWS_PER_BLOCK) {
+        if (fread(matrix + row * N, sizeof(int), ROWS_PER_BLOCK * N, fp) != (size_t) (ROWS_PER_BLOCK * N)) {
+            printf("Error reading the file %s\n", filename);
+            exit(EXIT_FAILURE);
+        }
+
+        CHECK (cudaMemcpyAsync (device_matrix + row * N, matrix + row * N, ROWS_PER_BLOCK * N * sizeof(int), cudaMemcpyHostToDevice, stream));
+        sortSubsequence<<<ROWS_PER_BLOCK, 1, 0, stream>>>(device_matrix + row * N, 0);
+
+        // the block is fingerprinted while the device sorts it
+        add_to_fingerprint(&input_fingerprint, matrix + row * N, ROWS_PER_BLOCK * N);
+    }
+
+    fclose(fp);
+
+    // Wait for the sorting kernels to finish
+    CHECK (cudaStreamSynchronize (stream));
+    CHECK (cudaStreamDestroy (stream));
+    printf ("copy the host data to the device memory and sort the rows\n");
+
+    float load_time = get_delta_time();
+    printf("GPU read, copy and sort of the rows time = %.6fs\n", load_time);
     
     // Sorting iterations
     int numSubsequences = N;
@@ -118,14 +165,7 @@ int main (int argc, char **argv)  {
 
         printf("\n>> iteration %d\n", iteration);
 
-        if (iteration == 0) {
-            sortSubsequence<<<grid, block>>>(device_matrix, iteration);
-
-            // Wait for the sorting kernel to finish
-            cudaDeviceSynchronize();
-        
-            // print_device_array<<<1, 1>>>(device_matrix, N*N, N*N);
-        } 
+        // the rows were sorted (iteration 0) while the file was read
 
         numSubsequences /= 2;
 
@@ -142,10 +182,16 @@ int main (int argc, char **argv)  {
     int * sorted_matrix = (int *)malloc( sizeof(int) * N * N );
     CHECK (cudaMemcpy (sorted_matrix, device_matrix, sizeof(int) * N * N, cudaMemcpyDeviceToHost));
 
-    validate(sorted_matrix);
+    validate(sorted_matrix, &input_fingerprint);
+
+    float merge_time = get_delta_time();
+    printf("GPU merges time = %.6fs\n", merge_time);
+    printf("GPU execution time (read, copy and sort) = %.6fs\n", load_time + merge_time);
 
-    float exec_time = get_delta_time();
-    printf("GPU execution time = %.6fs\n", exec_time);
+    // write the sorted sequence, if an output file is given, out of the measured time
+    if (argc > 1) {
+        write_file(argv[1], sorted_matrix);
+    }
 
     // free device global memory 
     CHECK (cudaFree (device_matrix));
@@ -178,12 +224,12 @@ int main (int argc, char **argv)  {
         }
     }	
 
-    validate(matrix);
+    validate(matrix, &input_fingerprint);
 
     float exec_time_cpu = get_delta_time();
     printf("CPU execution time = %.6fs\n", exec_time_cpu);
 
-    free(matrix);
+    CHECK (cudaFreeHost(matrix));
 
     return 0;
 }
@@ -273,27 +319,74 @@ static double get_delta_time(void)
 }
 
 
-void validate(int *matrix) {
+static inline unsigned long long hash(int value) {
+    unsigned long long x = (unsigned int)value + 0x9e3779b97f4a7c15ULL;   // splitmix64 finalizer
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
 
-    int size = N * N;
-    int i;
-    for (i = 0; i < size; i++) {
 
-        if (i == (size - 1))  {
-            printf ("Everything is OK!\n");
-            break;
-        }
+void add_to_fingerprint(struct Fingerprint *fingerprint, int *values, int n) {
+    for (int i = 0; i < n; i++) {
+        fingerprint->sum += (unsigned int)values[i];
+        fingerprint->parity ^= (unsigned int)values[i];
+        fingerprint->hash_sum += hash(values[i]);
+    }
+}
 
+
+void validate(int *matrix, struct Fingerprint *input_fingerprint) {
+
+    int size = N * N;
+    int i;
+    for (i = 0; i < size - 1; i++) {
         if (matrix[i] > matrix[i+1]) { 
             printf ("Error in position %d between element %d and %d\n", i, matrix[i], matrix[i+1]);
             break;
         }
     }
 
+    if (i == size - 1) {
+        struct Fingerprint output_fingerprint = {0, 0, 0};
+        add_to_fingerprint(&output_fingerprint, matrix, size);
+
+        if (output_fingerprint.sum != input_fingerprint->sum || output_fingerprint.parity != input_fingerprint->parity ||
+            output_fingerprint.hash_sum != input_fingerprint->hash_sum) {
+            printf ("Error: the sorted matrix does not have the same integers as the file\n");
+        } else {
+            printf ("Everything is OK!\n");
+        }
+    }
+
     printf ("\n");
 }
 
 
+/**
+ *   writes the sorted matrix in the format of the input files: the number of integers and the integers
+ */
+
+void write_file(const char *filename, int *matrix) {
+    FILE *fp = fopen(filename, "wb");
+
+    if (fp == NULL) {
+        printf("Error: could not open file %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    int size = N * N;
+    bool written = fwrite(&size, sizeof(int), 1, fp) == 1 && fwrite(matrix, sizeof(int), size, fp) == (size_t) size;
+
+    if (fclose(fp) != 0 || !written) {
+        printf("Error writing the file %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("sorted sequence written to %s\n", filename);
+}
+
+
 void print_array(int arr[], int size, int file_size) {
     for (int i = file_size - size; i < file_size; i++) {
         printf("%d ", arr[i]);
@@ -0,0 +1,265 @@
+/**
+ *  \file wordCounter.c (implementation file)
+ *
+ *  \brief Word counter: number of words and of words with each vowel of a UTF-8 text.
+ *
+ *  The bytes of a character are packed in an integer as they are read (e.g. "“" is
+ *  0xe2809c), which is looked up in a table of the ASCII characters or of the two-byte
+ *  characters starting with 0xc3 (the accented vowels), or compared with the few other
+ *  multi-byte separation characters and apostrophes.
+ *
+ *  \author Artur Romão e João Reis - March 2023
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "wordCounter.h"
+
+/** \brief the character is one of the vowels (one bit per vowel: A, E, I, O, U, Y) */
+#define VOWEL_A 0x01
+#define VOWEL_E 0x02
+#define VOWEL_I 0x04
+#define VOWEL_O 0x08
+#define VOWEL_U 0x10
+#define VOWEL_Y 0x20
+
+/** \brief the character is a separation character */
+#define SEPARATION 0x40
+
+/** \brief the character is an apostrophe, which does not start a word */
+#define APOSTROPHE 0x80
+
+
+/** \brief classes of the one-byte characters, only ASCII ones are separation characters */
+static const unsigned char ascii_class[256] = {
+  [0x00] = SEPARATION, ['\t'] = SEPARATION, ['\n'] = SEPARATION, ['\r'] = SEPARATION, [' '] = SEPARATION,
+  ['!'] = SEPARATION, ['"'] = SEPARATION, ['('] = SEPARATION, [')'] = SEPARATION, ['.'] = SEPARATION,
+  [','] = SEPARATION, [':'] = SEPARATION, [';'] = SEPARATION, ['?'] = SEPARATION, ['['] = SEPARATION,
+  [']'] = SEPARATION, ['-'] = SEPARATION,
+  ['\''] = APOSTROPHE,
+  ['A'] = VOWEL_A, ['a'] = VOWEL_A, ['E'] = VOWEL_E, ['e'] = VOWEL_E, ['I'] = VOWEL_I, ['i'] = VOWEL_I,
+  ['O'] = VOWEL_O, ['o'] = VOWEL_O, ['U'] = VOWEL_U, ['u'] = VOWEL_U, ['Y'] = VOWEL_Y, ['y'] = VOWEL_Y,
+};
+
+/** \brief classes of the two-byte characters 0xc380 to 0xc3bf (À to ÿ) */
+static const unsigned char latin1_class[64] = {
+  [0x00] = VOWEL_A, [0x01] = VOWEL_A, [0x02] = VOWEL_A, [0x03] = VOWEL_A,   // À Á Â Ã
+  [0x08] = VOWEL_E, [0x09] = VOWEL_E, [0x0a] = VOWEL_E,                     // È É Ê
+  [0x0c] = VOWEL_I, [0x0d] = VOWEL_I,                                       // Ì Í
+  [0x12] = VOWEL_O, [0x13] = VOWEL_O, [0x14] = VOWEL_O, [0x15] = VOWEL_O,   // Ò Ó Ô Õ
+  [0x19] = VOWEL_U, [0x1a] = VOWEL_U,                                       // Ù Ú
+  [0x20] = VOWEL_A, [0x21] = VOWEL_A, [0x22] = VOWEL_A, [0x23] = VOWEL_A,   // à á â ã
+  [0x28] = VOWEL_E, [0x29] = VOWEL_E, [0x2a] = VOWEL_E,                     // è é ê
+  [0x2c] = VOWEL_I, [0x2d] = VOWEL_I,                                       // ì í
+  [0x32] = VOWEL_O, [0x33] = VOWEL_O, [0x34] = VOWEL_O, [0x35] = VOWEL_O,   // ò ó ô õ
+  [0x39] = VOWEL_U, [0x3a] = VOWEL_U,                                       // ù ú
+};
+
+
+/**
+ *  \brief Class of a character.
+ *
+ *  \param character contains the bytes of the character
+ *
+ *  \return vowel, separation character, apostrophe or 0 for any other character.
+ */
+static int class_of(unsigned int character) {
+    if (character < 0x100) return ascii_class[character];
+    if (character >= 0xc380 && character <= 0xc3bf) return latin1_class[character - 0xc380];
+
+    switch (character) {
+        case 0xc2ab: case 0xc2bb:                                     // « »
+        case 0xe2809c: case 0xe2809d:                                 // “ ”
+        case 0xe28093: case 0xe28094: case 0xe280a6:                  // – — …
+            return SEPARATION;
+
+        case 0xe28098: case 0xe28099:                                 // ‘ ’
+            return APOSTROPHE;
+
+        default:
+            return 0;
+    }
+}
+
+/**
+ *  \brief Number of bytes of a character.
+ *
+ *  \param byte contains the first byte of the character
+ *
+ *  \return size of the character.
+ */
+static int character_size(unsigned char byte) {
+    if (byte < 0xc0) return 1;       // 0xxxxxxx (or a byte that does not start a character)
+    if (byte < 0xe0) return 2;       // 110xxxxx
+    if (byte < 0xf0) return 3;       // 1110xxxx
+    return 4;                        // 11110xxx
+}
+
+/**
+ *  \brief Start a word counter.
+ *
+ *  \param counter contains the counter
+ */
+void counter_init(struct WordCounter *counter) {
+    memset(counter, 0, sizeof(struct WordCounter));
+}
+
+/**
+ *  \brief Count the words of a buffer, which continues the text fed so far.
+ *
+ *  \param counter contains the counter
+ *  \param data contains the bytes of the text
+ *  \param n contains the number of bytes
+ */
+void counter_feed(struct WordCounter *counter, const char *data, size_t n) {
+    struct WordCounter c = *counter;   // in registers while the buffer is read
+
+    for (size_t i = 0; i < n; i++) {
+        unsigned char byte = (unsigned char)data[i];
+
+        if (c.missing_bytes == 0) {
+            c.character = byte;
+            c.missing_bytes = character_size(byte) - 1;
+        } else {
+            c.character = (c.character << 8) | byte;
+            c.missing_bytes--;
+        }
+        if (c.missing_bytes != 0) continue;
+
+        int class = class_of(c.character);
+
+        if (class & SEPARATION) {
+            c.in_word = false;
+            c.vowels_seen = 0;
+            continue;
+        }
+
+        if (!c.in_word && !(class & APOSTROPHE)) {
+            c.count.nWords++;
+            c.in_word = true;
+        }
+
+        // a word is counted once for each vowel
+        int vowel = class & ~c.vowels_seen & (VOWEL_A | VOWEL_E | VOWEL_I | VOWEL_O | VOWEL_U | VOWEL_Y);
+        if (vowel) {
+            c.vowels_seen |= vowel;
+            if (vowel == VOWEL_A) c.count.nWordsA++;
+            else if (vowel == VOWEL_E) c.count.nWordsE++;
+            else if (vowel == VOWEL_I) c.count.nWordsI++;
+            else if (vowel == VOWEL_O) c.count.nWordsO++;
+            else if (vowel == VOWEL_U) c.count.nWordsU++;
+            else c.count.nWordsY++;
+        }
+    }
+
+    *counter = c;
+}
+
+/**
+ *  \brief Counts of the text fed so far.
+ *
+ *  \param counter contains the counter
+ *
+ *  \return number of words and of words with each vowel.
+ */
+struct WordCount counter_result(struct WordCounter *counter) {
+    return counter->count;
+}
+
+/**
+ *  \brief Add counts to a total.
+ *
+ *  \param total contains the total
+ *  \param count contains the counts to add
+ */
+void merge_counts(struct WordCount *total, struct WordCount *count) {
+    total->nWords  += count->nWords;
+    total->nWordsA += count->nWordsA;
+    total->nWordsE += count->nWordsE;
+    total->nWordsI += count->nWordsI;
+    total->nWordsO += count->nWordsO;
+    total->nWordsU += count->nWordsU;
+    total->nWordsY += count->nWordsY;
+}
+
+/**
+ *  \brief Length of the buffer up to its last separation character.
+ *
+ *  \param data contains the bytes of the text
+ *  \param n contains the number of bytes
+ *
+ *  \return number of bytes up to the last separation character (included), 0 if there is none.
+ */
+size_t word_boundary(const char *data, size_t n) {
+    while (n > 0 && !(ascii_class[(unsigned char)data[n - 1]] & SEPARATION)) n--;
+    return n;
+}
+
+/**
+ *  \brief Structure with the piece of the text counted by a thread.
+ */
+struct Piece {
+  const char *data;
+  size_t n;
+  struct WordCount count;
+};
+
+/**
+ *  \brief Count the words of a piece of the text.
+ *
+ *  \param arg contains the piece
+ */
+static void *count_piece(void *arg) {
+    struct Piece *piece = (struct Piece *)arg;
+    struct WordCounter counter;
+
+    counter_init(&counter);
+    counter_feed(&counter, piece->data, piece->n);
+    piece->count = counter_result(&counter);
+    return NULL;
+}
+
+/**
+ *  \brief Count the words of a text in memory with a number of threads.
+ *
+ *  \param data contains the bytes of the text
+ *  \param n contains the number of bytes
+ *  \param n_threads contains the number of threads
+ *  \param count will store the number of words and of words with each vowel
+ */
+void count_buffer(const char *data, size_t n, int n_threads, struct WordCount *count) {
+    struct Piece *pieces = (struct Piece *)malloc(n_threads * sizeof(struct Piece));
+    pthread_t *threads = (pthread_t *)malloc(n_threads * sizeof(pthread_t));
+    size_t start = 0;
+
+    // piece t ends at the first separation character after (t + 1) / n_threads of the text
+    for (int t = 0; t < n_threads; t++) {
+        size_t end = (t == n_threads - 1) ? n : n / n_threads * (t + 1);
+        if (end < start) end = start;
+        while (end > start && end < n && !(ascii_class[(unsigned char)data[end - 1]] & SEPARATION)) end++;
+
+        pieces[t].data = data + start;
+        pieces[t].n = end - start;
+        start = end;
+    }
+
+    for (int t = 1; t < n_threads; t++) {
+        if (pthread_create(&threads[t], NULL, count_piece, &pieces[t]) != 0) {
+            perror("[error] on creating thread counter");
+            exit(EXIT_FAILURE);
+        }
+    }
+    count_piece(&pieces[0]);   // the calling thread counts the first piece
+
+    memset(count, 0, sizeof(struct WordCount));
+    for (int t = 0; t < n_threads; t++) {
+        if (t > 0) pthread_join(threads[t], NULL);
+        merge_counts(count, &pieces[t].count);
+    }
+
+    free(threads);
+    free(pieces);
+}
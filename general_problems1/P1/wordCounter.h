@@ -0,0 +1,117 @@
+/**
+ *  \file wordCounter.h (interface file)
+ *
+ *  \brief Word counter: number of words and of words with each vowel of a UTF-8 text.
+ *
+ *  The counter has no global state, so any number of them can be used at the same
+ *  time. The text is fed to a counter in buffers of any size, split anywhere (even in
+ *  the middle of a word or of a multi-byte character), and the state at the end of a
+ *  buffer is carried to the next one. The counts of separate pieces of a text, split
+ *  after a separation character (see word_boundary), are merged with merge_counts.
+ *
+ *  A word starts at its first character that is not a separation character nor an
+ *  apostrophe and ends at the next separation character; it is counted once for each
+ *  vowel (A, E, I, O, U, Y, with or without accents) it contains.
+ *
+ *  \author Artur Romão e João Reis - March 2023
+ */
+
+#ifndef WORD_COUNTER_H
+#define WORD_COUNTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+
+/**
+ *  \brief Structure with the number of words and of words with each vowel.
+ */
+struct WordCount {
+  long long nWords;
+  long long nWordsA;
+  long long nWordsE;
+  long long nWordsI;
+  long long nWordsO;
+  long long nWordsU;
+  long long nWordsY;
+};
+
+/**
+ *  \brief Structure with a word counter.
+ *
+ *   Besides the counts, it keeps the bytes of the character being read (character)
+ *   and how many are missing, whether the last character was in a word and the vowels
+ *   already seen in that word (one bit per vowel).
+ */
+struct WordCounter {
+  struct WordCount count;
+  unsigned int character;
+  int missing_bytes;
+  bool in_word;
+  unsigned int vowels_seen;
+};
+
+
+/**
+ *  \brief Start a word counter.
+ *
+ *  \param counter contains the counter
+ */
+extern void counter_init(struct WordCounter *counter);
+
+/**
+ *  \brief Count the words of a buffer, which continues the text fed so far.
+ *
+ *  \param counter contains the counter
+ *  \param data contains the bytes of the text
+ *  \param n contains the number of bytes
+ */
+extern void counter_feed(struct WordCounter *counter, const char *data, size_t n);
+
+/**
+ *  \brief Counts of the text fed so far.
+ *
+ *  A word is counted as soon as it starts, so the counts are final up to the last byte fed.
+ *
+ *  \param counter contains the counter
+ *
+ *  \return number of words and of words with each vowel.
+ */
+extern struct WordCount counter_result(struct WordCounter *counter);
+
+/**
+ *  \brief Add counts to a total.
+ *
+ *  \param total contains the total
+ *  \param count contains the counts to add
+ */
+extern void merge_counts(struct WordCount *total, struct WordCount *count);
+
+/**
+ *  \brief Length of the buffer up to its last separation character.
+ *
+ *  The text may be split there: the counts of the two pieces, each counted from the
+ *  start, add up to those of the whole text. Only the ASCII separation characters are
+ *  looked for, which end a character in a valid UTF-8 text.
+ *
+ *  \param data contains the bytes of the text
+ *  \param n contains the number of bytes
+ *
+ *  \return number of bytes up to the last separation character (included), 0 if there is none.
+ */
+extern size_t word_boundary(const char *data, size_t n);
+
+/**
+ *  \brief Count the words of a text in memory with a number of threads.
+ *
+ *  The text is split in as many pieces as threads, after a separation character, and
+ *  each thread counts its piece where it is, without copying it.
+ *
+ *  \param data contains the bytes of the text
+ *  \param n contains the number of bytes
+ *  \param n_threads contains the number of threads
+ *  \param count will store the number of words and of words with each vowel
+ */
+extern void count_buffer(const char *data, size_t n, int n_threads, struct WordCount *count);
+
+#endif /* WORD_COUNTER_H */
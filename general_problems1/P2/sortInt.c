@@ -1,83 +1,447 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
 
 //////////////////////////// Compile and Run ////////////////////////////
 //                                                                     //
-//  gcc -Wall -O3 -o sortInt sortInt.c                                 //
-//  ./sortInt datSeq32.bin                                             //
+//  gcc -Wall -O3 -o sortInt sortInt.c -lpthread                       //
+//  ./sortInt dataset/datSeq32.bin                                     //
+//  ./sortInt dataset/datSeq32.bin sorted.bin  (writes the sorted      //
+//                                              sequence)              //
+//  ./sortInt -n 4 dataset/datSeq256K.bin      (4 threads, default:    //
+//                                              one per processor)     //
 //                                                                     //
 /////////////////////////////////////////////////////////////////////////
 
-void print(int *val, int N) {
-    for (int j = 0; j < N; j++) {
-        printf("%d\n", val[j]);
-    } 
-}
+#define LOAD_BLOCK_SIZE (1 << 20)   // number of integers read from the file at a time
 
-void validate(int *val, int N) {
-    int i;
-    for (i = 0; i < N; i++) {
+#define INSERTION_SORT_THRESHOLD 24         // ranges smaller than this are sorted by insertion sort
+#define NINTHER_THRESHOLD 128               // ranges larger than this take the pivot from 9 samples, not 3
+#define PARTIAL_INSERTION_SORT_LIMIT 8      // moves allowed when checking if a partitioned range is sorted
+#define MIN_PARALLEL_SIZE (1 << 14)         // ranges smaller than this are not given to other threads
+#define TASKS_PER_THREAD_LOG 3              // the ranges are split in about 2^3 tasks per thread
 
-        if (i == (N - 1))  {
-            printf ("Everything is OK!\n");
-            break;
-        }
+// order-independent fingerprint of the integers (sum, xor and sum of a hash, modulo 2^64),
+// the sorted sequence must have the same one as the file
+struct Fingerprint {
+    unsigned long long sum;
+    unsigned long long parity;
+    unsigned long long hash_sum;
+};
+
+static inline unsigned long long hash(int value) {
+    unsigned long long x = (unsigned int)value + 0x9e3779b97f4a7c15ULL;   // splitmix64 finalizer
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+void add_to_fingerprint(struct Fingerprint *fingerprint, int *val, int N) {
+    for (int i = 0; i < N; i++) {
+        fingerprint->sum += (unsigned int)val[i];
+        fingerprint->parity ^= (unsigned int)val[i];
+        fingerprint->hash_sum += hash(val[i]);
+    }
+}
 
+void validate(int *val, int N, struct Fingerprint *input_fingerprint) {
+    for (int i = 0; i < N - 1; i++) {
         if (val[i] > val[i+1]) { 
             printf ("Error in position %d between element %d and %d\n", i, val[i], val[i+1]);
-            break;
+            return;
+        }
+    }
+
+    struct Fingerprint output_fingerprint = {0, 0, 0};
+    add_to_fingerprint(&output_fingerprint, val, N);
+
+    if (output_fingerprint.sum != input_fingerprint->sum || output_fingerprint.parity != input_fingerprint->parity ||
+        output_fingerprint.hash_sum != input_fingerprint->hash_sum) {
+        printf ("Error: the sorted sequence does not have the same integers as the file\n");
+        return;
+    }
+
+    printf ("Everything is OK!\n");
+}
+
+// writes the sorted sequence in the format of the input files: the number of integers and the integers
+int write_file(char *filename, int *val, int N) {
+    FILE *file = fopen(filename, "wb");
+
+    if (file == NULL) {
+        printf("Error opening the file %s\n", filename);
+        return 1;
+    }
+
+    int written = fwrite(&N, sizeof(int), 1, file) == 1 && fwrite(val, sizeof(int), N, file) == (size_t)N;
+
+    if (fclose(file) != 0 || !written) {
+        printf("Error writing the file %s\n", filename);
+        return 1;
+    }
+    return 0;
+}
+
+////////////////////// Parallel pattern-defeating introsort //////////////////////
+//
+// Quicksort with the pivot taken as the median of 3 samples, or of the medians of
+// 3 groups of 3 samples in large ranges, whose worst case is bounded by a heapsort
+// once too many partitions were unbalanced (introsort); the partitions of sorted,
+// reversed or patterned ranges are detected and those ranges finished by insertion
+// sort, and the elements of an unbalanced partition are shuffled to break patterns
+// (pdqsort). Runs of elements equal to the pivot of the parent range are put in
+// place with one partition and skipped, so duplicates do not make it quadratic.
+//
+// The left part of each partition of a large range is given to the pool of threads,
+// down to a depth that gives a few tasks per thread, and the right part is sorted
+// by the same thread.
+
+static inline void swap(int *a, int *b) {
+    int temp = *a;
+    *a = *b;
+    *b = temp;
+}
+
+// sorting network of 2 and 3 elements
+static inline void sort2(int *a, int *b) {
+    if (*b < *a) swap(a, b);
+}
+
+static inline void sort3(int *a, int *b, int *c) {
+    sort2(a, b);
+    sort2(b, c);
+    sort2(a, b);
+}
+
+void insertion_sort(int *val, int begin, int end) {
+    for (int i = begin + 1; i < end; i++) {
+        int element = val[i];
+        int j = i;
+
+        while (j > begin && val[j-1] > element) {
+            val[j] = val[j-1];
+            j--;
+        }
+        val[j] = element;
+    }
+}
+
+// the element before the range is not greater than any of the range, so it stops the moves
+void unguarded_insertion_sort(int *val, int begin, int end) {
+    for (int i = begin + 1; i < end; i++) {
+        int element = val[i];
+        int j = i;
+
+        while (val[j-1] > element) {
+            val[j] = val[j-1];
+            j--;
+        }
+        val[j] = element;
+    }
+}
+
+// insertion sort that gives up after PARTIAL_INSERTION_SORT_LIMIT moves, returns true if the range is sorted
+bool partial_insertion_sort(int *val, int begin, int end) {
+    int moves = 0;
+
+    for (int i = begin + 1; i < end; i++) {
+        if (val[i] < val[i-1]) {
+            int element = val[i];
+            int j = i;
+
+            do {
+                val[j] = val[j-1];
+                j--;
+            } while (j > begin && val[j-1] > element);
+            val[j] = element;
+
+            moves += i - j;
+            if (moves > PARTIAL_INSERTION_SORT_LIMIT) return false;
         }
+    }
+    return true;
+}
+
+void sift_down(int *val, int root, int N) {
+    int element = val[root];
+
+    while (2 * root + 1 < N) {
+        int child = 2 * root + 1;
+        if (child + 1 < N && val[child+1] > val[child]) child++;
+        if (val[child] <= element) break;
+
+        val[root] = val[child];
+        root = child;
+    }
+    val[root] = element;
+}
+
+void heapsort(int *val, int N) {
+    for (int i = N / 2 - 1; i >= 0; i--) {
+        sift_down(val, i, N);
+    }
+    for (int i = N - 1; i > 0; i--) {
+        swap(&val[0], &val[i]);
+        sift_down(val, 0, i);
+    }
+}
+
+// partitions the range around its first element, the pivot: the smaller elements to its left and the others
+// to its right; there must be an element not smaller than the pivot after it (the greatest sample)
+int partition_right(int *val, int begin, int end, bool *already_partitioned) {
+    int pivot = val[begin];
+    int first = begin;
+    int last = end;
+
+    while (val[++first] < pivot);
+
+    if (first - 1 == begin) {
+        while (first < last && !(val[--last] < pivot));
+    } else {
+        while (!(val[--last] < pivot));
+    }
+
+    // no element had to be swapped
+    *already_partitioned = first >= last;
+
+    while (first < last) {
+        swap(&val[first], &val[last]);
+        while (val[++first] < pivot);
+        while (!(val[--last] < pivot));
+    }
+
+    int pivot_position = first - 1;
+    val[begin] = val[pivot_position];
+    val[pivot_position] = pivot;
+    return pivot_position;
+}
+
+// partitions the range around its first element, the pivot: the elements not greater than it to its left,
+// which are all equal to it when no element of the range is smaller than the pivot
+int partition_left(int *val, int begin, int end) {
+    int pivot = val[begin];
+    int first = begin;
+    int last = end;
+
+    while (pivot < val[--last]);
+
+    if (last + 1 == end) {
+        while (first < last && !(pivot < val[++first]));
+    } else {
+        while (!(pivot < val[++first]));
+    }
 
+    while (first < last) {
+        swap(&val[first], &val[last]);
+        while (pivot < val[--last]);
+        while (!(pivot < val[++first]));
     }
+
+    val[begin] = val[last];
+    val[last] = pivot;
+    return last;
 }
 
-void compareAndSwap(int *val, int i, int j, int dir) {
-    if ((val[i] > val[j]) == dir) {
-        int temp = val[i];
-        val[i] = val[j];
-        val[j] = temp;
+// a range still to be sorted, the same arguments as introsort
+struct Task {
+    int begin, end;
+    int bad_allowed;
+    bool leftmost;
+    int depth;
+};
+
+static int *values;                 // sequence being sorted
+static struct Task *tasks;          // ranges waiting for a thread (a stack)
+static int n_tasks;
+static int pending_tasks;           // ranges waiting or being sorted
+static int spawn_depth;             // ranges deeper than this are sorted by the thread that partitioned them
+static pthread_mutex_t tasks_access = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t tasks_changed = PTHREAD_COND_INITIALIZER;
+
+void spawn(struct Task task) {
+    pthread_mutex_lock(&tasks_access);
+    tasks[n_tasks++] = task;
+    pending_tasks++;
+    pthread_cond_signal(&tasks_changed);
+    pthread_mutex_unlock(&tasks_access);
+}
+
+// sorts the range [begin, end); bad_allowed is the number of unbalanced partitions left before the heapsort,
+// leftmost is false if the element before the range is not greater than any of the range
+void introsort(int *val, int begin, int end, int bad_allowed, bool leftmost, int depth) {
+    while (true) {
+        int size = end - begin;
+
+        if (size < INSERTION_SORT_THRESHOLD) {
+            if (leftmost) {
+                insertion_sort(val, begin, end);
+            } else {
+                unguarded_insertion_sort(val, begin, end);
+            }
+            return;
+        }
+
+        // pivot to the first position, the greatest sample to the last one
+        int half = size / 2;
+        if (size > NINTHER_THRESHOLD) {
+            sort3(&val[begin], &val[begin + half], &val[end - 1]);
+            sort3(&val[begin + 1], &val[begin + half - 1], &val[end - 2]);
+            sort3(&val[begin + 2], &val[begin + half + 1], &val[end - 3]);
+            sort3(&val[begin + half - 1], &val[begin + half], &val[begin + half + 1]);
+            swap(&val[begin], &val[begin + half]);
+        } else {
+            sort3(&val[begin + half], &val[begin], &val[end - 1]);
+        }
+
+        // the pivot is equal to the one of the parent range, before this one: no element is smaller,
+        // the elements equal to it are put in place and skipped
+        if (!leftmost && !(val[begin - 1] < val[begin])) {
+            begin = partition_left(val, begin, end) + 1;
+            continue;
+        }
+
+        bool already_partitioned;
+        int pivot_position = partition_right(val, begin, end, &already_partitioned);
+        int left_size = pivot_position - begin;
+        int right_size = end - (pivot_position + 1);
+
+        if (left_size < size / 8 || right_size < size / 8) {
+            if (--bad_allowed == 0) {
+                heapsort(val + begin, size);
+                return;
+            }
+
+            // swap some elements of each part, so a pattern in the input does not unbalance it again
+            if (left_size >= INSERTION_SORT_THRESHOLD) {
+                int quarter = left_size / 4;
+                swap(&val[begin], &val[begin + quarter]);
+                swap(&val[pivot_position - 1], &val[pivot_position - quarter]);
+
+                if (left_size > NINTHER_THRESHOLD) {
+                    swap(&val[begin + 1], &val[begin + quarter + 1]);
+                    swap(&val[begin + 2], &val[begin + quarter + 2]);
+                    swap(&val[pivot_position - 2], &val[pivot_position - quarter - 1]);
+                    swap(&val[pivot_position - 3], &val[pivot_position - quarter - 2]);
+                }
+            }
+
+            if (right_size >= INSERTION_SORT_THRESHOLD) {
+                int quarter = right_size / 4;
+                swap(&val[pivot_position + 1], &val[pivot_position + 1 + quarter]);
+                swap(&val[end - 1], &val[end - quarter]);
+
+                if (right_size > NINTHER_THRESHOLD) {
+                    swap(&val[pivot_position + 2], &val[pivot_position + 2 + quarter]);
+                    swap(&val[pivot_position + 3], &val[pivot_position + 3 + quarter]);
+                    swap(&val[end - 2], &val[end - quarter - 1]);
+                    swap(&val[end - 3], &val[end - quarter - 2]);
+                }
+            }
+        } else if (already_partitioned && partial_insertion_sort(val, begin, pivot_position) &&
+                   partial_insertion_sort(val, pivot_position + 1, end)) {
+            // a balanced partition with no swaps, and both parts (nearly) sorted
+            return;
+        }
+
+        // the left part by another thread, or now, the right one in the next iteration
+        struct Task left = { begin, pivot_position, bad_allowed, leftmost, depth + 1 };
+        if (depth < spawn_depth && size >= MIN_PARALLEL_SIZE) {
+            spawn(left);
+        } else {
+            introsort(val, left.begin, left.end, left.bad_allowed, left.leftmost, left.depth);
+        }
+
+        begin = pivot_position + 1;
+        leftmost = false;
+        depth++;
     }
 }
 
-void bitonicMerge(int *val, int low, int cnt, int dir) {
-    if (cnt > 1) {
-        int k = cnt / 2;
-        for (int i = low; i < low + k; i++) {
-            compareAndSwap(val, i, i + k, dir);
+// takes ranges until the sequence is sorted
+void *sorter(void *arg) {
+    while (true) {
+        pthread_mutex_lock(&tasks_access);
+        while (n_tasks == 0 && pending_tasks > 0) {
+            pthread_cond_wait(&tasks_changed, &tasks_access);
         }
-        bitonicMerge(val, low, k, dir);
-        bitonicMerge(val, low + k, k, dir);
+        if (n_tasks == 0) {
+            pthread_mutex_unlock(&tasks_access);
+            return NULL;
+        }
+        struct Task task = tasks[--n_tasks];
+        pthread_mutex_unlock(&tasks_access);
+
+        introsort(values, task.begin, task.end, task.bad_allowed, task.leftmost, task.depth);
+
+        pthread_mutex_lock(&tasks_access);
+        if (--pending_tasks == 0) pthread_cond_broadcast(&tasks_changed);
+        pthread_mutex_unlock(&tasks_access);
     }
 }
 
-void bitonicSortRecursive(int *val, int low, int cnt, int dir) {
-    if (cnt > 1) {
-        int k = cnt / 2;
-        bitonicSortRecursive(val, low, k, !dir);
-        bitonicSortRecursive(val, low + k, k, dir);
-        bitonicMerge(val, low, cnt, dir);
+void parallel_introsort(int *val, int N, int n_threads) {
+    int log_n = 0;
+    while ((1 << log_n) < n_threads) log_n++;
+    spawn_depth = (n_threads > 1) ? log_n + TASKS_PER_THREAD_LOG : 0;
+
+    // a range is given to the pool once per level above spawn_depth at most
+    values = val;
+    tasks = (struct Task *)malloc(((1 << spawn_depth) + 1) * sizeof(struct Task));
+    n_tasks = 0;
+    pending_tasks = 0;
+
+    // introsort: the heapsort is taken after log2(N) unbalanced partitions
+    int bad_allowed = 1;
+    while ((N >> bad_allowed) > 0) bad_allowed++;
+    spawn((struct Task){ 0, N, bad_allowed, true, 0 });
+
+    pthread_t *threads = (pthread_t *)malloc(n_threads * sizeof(pthread_t));
+    for (int t = 1; t < n_threads; t++) {
+        if (pthread_create(&threads[t], NULL, sorter, NULL) != 0) {
+            perror("[error] on creating a sorter thread");
+            exit(1);
+        }
     }
+    sorter(NULL);
+    for (int t = 1; t < n_threads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    free(threads);
+    free(tasks);
 }
 
-void bitonicSort(int *val, int N) {
-    bitonicSortRecursive(val, 0, N, 1);
+double get_time(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + 1.0e-9 * (double)t.tv_nsec;
 }
 
 int main(int argc, char *argv[]) {
 
-    if (argc < 2) {
-        printf("[usage]: %s filename\n", argv[0]);
-        return 1;
+    int n_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        if (opt != 'n' || atoi(optarg) < 1) {
+            printf("[usage]: %s [-n threads] filename [output filename]\n", argv[0]);
+            return 1;
+        }
+        n_threads = atoi(optarg);
     }
 
-    if (chdir("dataset") == -1) {
-        perror("chdir");
+    if (optind >= argc) {
+        printf("[usage]: %s [-n threads] filename [output filename]\n", argv[0]);
         return 1;
     }
+    if (n_threads < 1) n_threads = 1;
 
     FILE *file;
-    char *filename = argv[1];
+    char *filename = argv[optind];
     
     // Open binary file for reading
     file = fopen(filename, "rb");
@@ -95,25 +459,39 @@ int main(int argc, char *argv[]) {
     }
     printf("number of values = %d\n", N_values);
 
+    // the header must match the number of integers in the file
+    struct stat st;
+    if (fstat(fileno(file), &st) != 0 || N_values < 0 ||
+        (long long)st.st_size != (long long)sizeof(int) * (1 + (long long)N_values)) {
+        printf("Error: the header of the file does not match its size");
+        return 1;
+    }
+
     int *sequence = (int*)malloc(N_values * sizeof(int));
-    int i = 0;
+    struct Fingerprint input_fingerprint = {0, 0, 0};
+
+    // Read the contents of the file, in blocks of LOAD_BLOCK_SIZE integers
+    for (int i = 0; i < N_values; i += LOAD_BLOCK_SIZE) {
+        int count = (N_values - i < LOAD_BLOCK_SIZE) ? N_values - i : LOAD_BLOCK_SIZE;
 
-    // Read the contents of the file
-    int num;
-    while(fread(&num, sizeof(int), 1, file) == 1) {
-        sequence[i] = num;
-        i++;
+        if (fread(sequence + i, sizeof(int), count, file) != (size_t)count) {
+            printf("Error reading the file");
+            return 1;
+        }
+        add_to_fingerprint(&input_fingerprint, sequence + i, count);
     }
     
     // Close the file
     fclose(file);
 
-    quicksort(sequence, 0, N_values - 1);
-    
-    // Print the integers read from the file
-    // printf("sorted sequence:\n");
-    // print(sequence, N_values);
+    double start = get_time();
+    parallel_introsort(sequence, N_values, n_threads);
+    printf("sorted with %d threads in %.6fs\n", n_threads, get_time() - start);
 
-    validate(sequence, N_values);
+    validate(sequence, N_values, &input_fingerprint);
+
+    if (optind + 1 < argc && write_file(argv[optind + 1], sequence, N_values) != 0) {
+        return 1;
+    }
     return 0;
 }
\ No newline at end of file
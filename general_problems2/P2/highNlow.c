@@ -1,21 +1,141 @@
 #include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include <unistd.h>
 
 #define ARRAY_SIZE 16  // Size of the random generated sequence
 
+#define READ_BLOCK_SIZE (1 << 24)                   // integers read from the file at a time
+#define TYPED_HEADER_MAGIC ((int)0xff515344)        // first 32 bits of a header with the type of the elements
+#define MAX_TARGETS 1024                            // quantiles and ranks selected in one run
+#define HISTOGRAM_BITS 16                           // log2 of the number of bins counted in a round
+
+// an element to select: the one of rank k (from 0) of the sorted sequence, which is in a bin of values
+// (see select_targets); below is the number of elements in the bins before it
+struct Target {
+    double quantile;    // -1 if the rank was given
+    long long k;
+    unsigned long long bin;
+    long long below;
+};
+
 void print_numbers(int *numbers, int size);
+void random_min_max(int rank, int size);
+int *read_block(char *filename, int rank, int size, long long *n_values, long long *n_local);
+int parse_targets(char *list, int is_quantile, struct Target *targets, int n_targets);
+int select_targets(int *values, long long n_local, struct Target *targets, int n_targets, int global_min, int global_max);
 
 
 int main(int argc, char** argv) {
     int rank, size;
-    int* random_numbers;
 
     MPI_Init(&argc, &argv);
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size (MPI_COMM_WORLD, &size);
 
+    // every process parses the same arguments
+    char *filename = NULL;
+    struct Target targets[MAX_TARGETS];
+    int n_targets = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:q:k:")) != -1) {
+        switch (opt) {
+            case 'f':
+                filename = optarg;
+                break;
+            case 'q':
+            case 'k':
+                n_targets = parse_targets(optarg, opt == 'q', targets, n_targets);
+                if (n_targets >= 0) break;
+                // fall through
+            default:
+                if (rank == 0) {
+                    printf("[usage]: %s                                 (min and max of %d random numbers)\n", argv[0], ARRAY_SIZE);
+                    printf("         %s -f filename [-q quantiles] [-k ranks]\n", argv[0]);
+                    printf("           -q 0.5,0.9,0.99 : quantiles, between 0 and 1 (the median is 0.5)\n");
+                    printf("           -k 1,1000       : k-th smallest values, from 1\n");
+                }
+                MPI_Finalize();
+                return 1;
+        }
+    }
+
+    if (filename == NULL) {
+        random_min_max(rank, size);
+        MPI_Finalize();
+        return 0;
+    }
+
+    // each process reads its block of the file
+    long long n_values, n_local;
+    int *values = read_block(filename, rank, size, &n_values, &n_local);
+    if (values == NULL) {
+        MPI_Finalize();
+        return 1;
+    }
+
+    // an empty file has no min, max or values to select
+    if (n_values == 0) {
+        if (rank == 0) printf("number of values = 0, the file has no integers\n");
+        free(values);
+        MPI_Finalize();
+        return 0;
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+
+    // a process may have no integers, when there are more processes than integers
+    int local_min = INT_MAX, local_max = INT_MIN;
+    for (long long i = 0; i < n_local; i++) {
+        if (values[i] < local_min) local_min = values[i];
+        if (values[i] > local_max) local_max = values[i];
+    }
+
+    int global_min, global_max;
+    MPI_Allreduce(&local_min, &global_min, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    MPI_Allreduce(&local_max, &global_max, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+
+    // rank of each target in the sorted sequence, a quantile q is its value ceil(q * n) (nearest rank)
+    for (int t = 0; t < n_targets; t++) {
+        if (targets[t].quantile >= 0) {
+            double position = targets[t].quantile * (double)n_values;
+            targets[t].k = (long long)position;
+            if ((double)targets[t].k < position) targets[t].k++;
+            targets[t].k--;
+        }
+        if (targets[t].k < 0) targets[t].k = 0;
+        if (targets[t].k >= n_values) targets[t].k = n_values - 1;
+    }
+
+    int rounds = select_targets(values, n_local, targets, n_targets, global_min, global_max);
+    double elapsed = MPI_Wtime() - start;
+
+    if (rank == 0) {
+        printf("number of values = %lld, %d processes\n", n_values, size);
+        printf("-> global min: %d\n-> global Max: %d\n", global_min, global_max);
+        for (int t = 0; t < n_targets; t++) {
+            if (targets[t].quantile >= 0) {
+                printf("-> quantile %g (value %lld): %d\n", targets[t].quantile, targets[t].k + 1, (int)((unsigned int)global_min + (unsigned int)targets[t].bin));
+            } else {
+                printf("-> value %lld: %d\n", targets[t].k + 1, (int)((unsigned int)global_min + (unsigned int)targets[t].bin));
+            }
+        }
+        printf("selected in %d rounds, %.6fs\n", rounds, elapsed);
+    }
+
+    free(values);
+    MPI_Finalize();
+    return 0;
+}
+
+// min and max of a random sequence generated by the root, scattered between the processes
+void random_min_max(int rank, int size) {
+    int* random_numbers;
+
     if(rank == 0) {
         srandom(getpid());
         random_numbers = malloc(ARRAY_SIZE * sizeof(int));
@@ -44,9 +164,176 @@ int main(int argc, char** argv) {
     MPI_Reduce(&local_max, &global_max, 1, MPI_INT, MPI_MAX, 0, MPI_COMM_WORLD);
 
     if(rank == 0) printf("-> global min: %d\n-> global Max: %d\n", global_min, global_max);
+}
 
-    MPI_Finalize();
-    return 0;
+// reads the block of the datSeq file of the process (MPI-IO), the file starts with the number of integers,
+// or with a typed header of 32-bit integers (as the files of CLE1_T3G3/prog2); returns NULL on a bad file
+int *read_block(char *filename, int rank, int size, long long *n_values, long long *n_local) {
+    MPI_File file;
+    MPI_Offset file_size, header_size = sizeof(int);
+
+    if (MPI_File_open(MPI_COMM_WORLD, filename, MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+        if (rank == 0) printf("Error opening the file %s\n", filename);
+        return NULL;
+    }
+
+    // every process reads the header, so all of them agree on the file
+    int first = 0, type = 0;
+    long long n = 0;
+    MPI_File_get_size(file, &file_size);
+    MPI_File_read_at(file, 0, &first, 1, MPI_INT, MPI_STATUS_IGNORE);
+    n = first;
+
+    if (first == TYPED_HEADER_MAGIC) {
+        MPI_File_read_at(file, sizeof(int), &type, 1, MPI_INT, MPI_STATUS_IGNORE);
+        MPI_File_read_at(file, 2 * sizeof(int), &n, 1, MPI_LONG_LONG, MPI_STATUS_IGNORE);
+        header_size = 2 * sizeof(int) + sizeof(long long);
+    }
+
+    if (type != 0 || n < 0 || file_size != header_size + n * (MPI_Offset)sizeof(int)) {
+        if (rank == 0) {
+            if (type != 0) printf("Error: only files of 32-bit integers are supported\n");
+            else printf("Error: the header of the file does not match its size\n");
+        }
+        MPI_File_close(&file);
+        return NULL;
+    }
+
+    // the blocks differ by one integer at most
+    long long block_start = n * rank / size;
+    long long block_end = n * (rank + 1) / size;
+    int *values = (int *)malloc((block_end - block_start + 1) * sizeof(int));
+
+    for (long long i = block_start; i < block_end; i += READ_BLOCK_SIZE) {
+        int count = (block_end - i < READ_BLOCK_SIZE) ? (int)(block_end - i) : READ_BLOCK_SIZE;
+
+        if (MPI_File_read_at(file, header_size + i * (MPI_Offset)sizeof(int), values + (i - block_start), count, MPI_INT, MPI_STATUS_IGNORE) != MPI_SUCCESS) {
+            printf("Error reading the file %s\n", filename);
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+
+    MPI_File_close(&file);
+    *n_values = n;
+    *n_local = block_end - block_start;
+    return values;
+}
+
+// adds the quantiles or the ranks (from 1) of a comma-separated list to the targets, returns their number, -1 if the list is wrong
+int parse_targets(char *list, int is_quantile, struct Target *targets, int n_targets) {
+    char *end = list;
+
+    while (*end != '\0') {
+        if (n_targets == MAX_TARGETS) return -1;
+
+        if (is_quantile) {
+            targets[n_targets].quantile = strtod(list, &end);
+            targets[n_targets].k = 0;
+            if (end == list || targets[n_targets].quantile < 0 || targets[n_targets].quantile > 1) return -1;
+        } else {
+            targets[n_targets].quantile = -1;
+            targets[n_targets].k = strtoll(list, &end, 10) - 1;
+            if (end == list || targets[n_targets].k < 0) return -1;
+        }
+        n_targets++;
+
+        if (*end == ',') end++;
+        else if (*end != '\0') return -1;
+        list = end;
+    }
+    return n_targets;
+}
+
+static int compare_bins(const void *a, const void *b) {
+    unsigned long long x = *(const unsigned long long *)a, y = *(const unsigned long long *)b;
+    return (x > y) - (x < y);
+}
+
+// position of a bin in a sorted array of distinct bins, -1 if it is not there
+static int find_bin(unsigned long long *bins, int n, unsigned long long bin) {
+    int low = 0, high = n;
+    while (low < high) {
+        int i = low + (high - low) / 2;
+        if (bins[i] < bin) low = i + 1; else high = i;
+    }
+    return (low < n && bins[low] == bin) ? low : -1;
+}
+
+// finds the targets without sorting, by histogram refinement: the values are split in bins of 2^shift values
+// from the global min, starting with one bin for all of them; in each round the bins of the targets are split
+// again in 2^bits bins, the elements of each one are counted (one MPI_Allreduce for all the targets) and
+// each target goes down to the bin where its rank falls, until the bins have one value; so the number of
+// rounds is the log of the range of values in base 2^bits (2 or 3 for 32-bit integers); the elements out of
+// the bins of all the targets are dropped, so each round goes through fewer of them; returns the number of rounds
+int select_targets(int *values, long long n_local, struct Target *targets, int n_targets, int global_min, int global_max) {
+    unsigned long long *parents = (unsigned long long *)malloc(n_targets * sizeof(unsigned long long));
+    long long *histogram = (long long *)malloc(((size_t)1 << HISTOGRAM_BITS) * sizeof(long long));
+    long long *global_histogram = (long long *)malloc(((size_t)1 << HISTOGRAM_BITS) * sizeof(long long));
+    int rounds = 0;
+
+    // bits of the distance from the global min to the values
+    int shift = 0;
+    unsigned long long range = (unsigned int)global_max - (unsigned int)global_min;
+    while ((range >> shift) != 0) shift++;
+
+    for (int t = 0; t < n_targets; t++) {
+        targets[t].bin = 0;
+        targets[t].below = 0;
+    }
+
+    while (shift > 0 && n_targets > 0) {
+        // the distinct bins of the targets, each one gets its part of the histogram
+        for (int t = 0; t < n_targets; t++) {
+            parents[t] = targets[t].bin;
+        }
+        qsort(parents, n_targets, sizeof(unsigned long long), compare_bins);
+        int n_parents = 1;
+        for (int t = 1; t < n_targets; t++) {
+            if (parents[t] != parents[n_parents - 1]) parents[n_parents++] = parents[t];
+        }
+
+        int parent_bits = 0;
+        while ((1 << parent_bits) < n_parents) parent_bits++;
+        int bits = HISTOGRAM_BITS - parent_bits;
+        if (bits < 1) bits = 1;
+        if (bits > shift) bits = shift;
+        int new_shift = shift - bits;
+        size_t histogram_size = (size_t)n_parents << bits;
+        unsigned long long mask = (1ULL << bits) - 1;
+
+        memset(histogram, 0, histogram_size * sizeof(long long));
+        long long kept = 0;
+
+        for (long long i = 0; i < n_local; i++) {
+            unsigned long long distance = (unsigned int)values[i] - (unsigned int)global_min;
+            int parent = (n_parents == 1) ? ((distance >> shift) == parents[0] ? 0 : -1) : find_bin(parents, n_parents, distance >> shift);
+            if (parent < 0) continue;
+
+            values[kept++] = values[i];
+            histogram[((size_t)parent << bits) | ((distance >> new_shift) & mask)]++;
+        }
+        n_local = kept;
+
+        MPI_Allreduce(histogram, global_histogram, (int)histogram_size, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+        rounds++;
+
+        for (int t = 0; t < n_targets; t++) {
+            long long *counts = global_histogram + ((size_t)find_bin(parents, n_parents, targets[t].bin) << bits);
+            unsigned long long bin = 0;
+
+            while (targets[t].below + counts[bin] <= targets[t].k) {
+                targets[t].below += counts[bin];
+                bin++;
+            }
+            targets[t].bin = (targets[t].bin << bits) | bin;
+        }
+        shift = new_shift;
+    }
+
+    free(parents);
+    free(histogram);
+    free(global_histogram);
+    return rounds;
 }
 
 void print_numbers(int *numbers, int size) {
@@ -54,4 +341,4 @@ void print_numbers(int *numbers, int size) {
         printf("%d ", numbers[i]);
     }
     printf("\n");
-} 
\ No newline at end of file
+}